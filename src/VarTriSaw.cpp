@@ -1,8 +1,7 @@
 #include "plugin.hpp"
-#include "variableshapeosc.h"
-#define MAX_POLYPHONY 16
+#include "vartrisawcore.h"
 
-struct VarTriSaw : Module {
+struct VarTriSaw : TimedModule {
 	enum ParamId {
 		GAINPARAM_PARAM,
 		PARAMS_LEN
@@ -22,12 +21,23 @@ struct VarTriSaw : Module {
 		LIGHTS_LEN
 	};
 
-	VariableShapeOscillator SQRosc[MAX_POLYPHONY], SAWosc[MAX_POLYPHONY];
-	float aft_amt[MAX_POLYPHONY];
-	float gain = 1.f;
+	VarTriSawCore vartrisaw;
+	// index into CULL_HOLD_TIMES
+	int cullHold = 2;
+	static constexpr float CULL_HOLD_TIMES[] = {0.f, .01f, .05f, .25f, 1.f};
+	// oscillators per voice, and indices into UNISON_DETUNES and UNISON_PW_SPREADS
+	int unison = 1;
+	int unisonDetune = 1;
+	int unisonPwSpread = 0;
+	// semitones either side
+	static constexpr float UNISON_DETUNES[] = {.05f, .1f, .25f, .5f};
+	static constexpr float UNISON_PW_SPREADS[] = {0.f, .05f, .1f, .2f};
+	// the left expander's messages, filled by an adjacent Polyfotz
+	VoiceBusMessage busMessages[2];
+	// voices played from the bus, 0 while playing from the cables
+	int busVoices = 0;
 
 	VarTriSaw() {
-		float pi_halves = std::atan(1) * 2;
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
 		configParam(GAINPARAM_PARAM, 0.f, 1.f, 1.f, "gain");
 		configInput(VOCT_INPUT, "v/oct");
@@ -35,36 +45,82 @@ struct VarTriSaw : Module {
 		configInput(GAININ_INPUT, "poly gain in");
 		configOutput(OUTSAW_OUTPUT, "pwm triSaw");
 		configOutput(OUTSQR_OUTPUT, "pwm square");
-		for (int i = 0; i < MAX_POLYPHONY; i++) {
-			SAWosc[i].Init(APP->engine->getSampleRate());
-			SQRosc[i].Init(APP->engine->getSampleRate());
-			SAWosc[i].SetWaveshape(0);
-			SQRosc[i].SetWaveshape(1);
-			aft_amt[i] = sin(pi_halves * i / MAX_POLYPHONY); // atan(1) = pi / 4 so we get values between 0 and 1
-		}
+		vartrisaw.init(APP->engine->getSampleRate());
+		setCullHold(cullHold);
+		getLeftExpander().producerMessage = &busMessages[0];
+		getLeftExpander().consumerMessage = &busMessages[1];
+	}
+
+	void setCullHold(int index) {
+		cullHold = index;
+		vartrisaw.setCullHoldTime(CULL_HOLD_TIMES[index]);
+	}
+
+	void setUnison(int voices, int detune, int pwSpread) {
+		unison = voices;
+		unisonDetune = detune;
+		unisonPwSpread = pwSpread;
+		vartrisaw.setUnison(unison, UNISON_DETUNES[unisonDetune], UNISON_PW_SPREADS[unisonPwSpread]);
+	}
+
+	void onSampleRateChange(const SampleRateChangeEvent& e) override {
+		vartrisaw.setSampleRate(e.sampleRate);
 	}
 
 	void process(const ProcessArgs& args) override {
-		int AFTchannels = inputs[AFTIN_INPUT].getChannels();
-		int OCTchannels = inputs[VOCT_INPUT].getChannels();
-		int GAINchannels = inputs[VOCT_INPUT].getChannels();
-		int channels = std::max(AFTchannels, OCTchannels);
+		uint64_t start = processTimer.begin();
+		int channels;
+		// a Polyfotz to the left plays us directly, unless V/Oct is patched
+		Module* left = getLeftExpander().module;
+		if (left && left->model == modelPolyfotz && !inputs[VOCT_INPUT].isConnected()) {
+			const VoiceBusMessage* bus = (const VoiceBusMessage*) getLeftExpander().consumerMessage;
+			busVoices = bus->voices;
+			channels = vartrisaw.processBus(*bus, params[GAINPARAM_PARAM].getValue(), outputs[OUTSAW_OUTPUT].getVoltages(), outputs[OUTSQR_OUTPUT].getVoltages());
+		}
+		else {
+			busVoices = 0;
+			VarTriSawCore::PolyInput voct = {inputs[VOCT_INPUT].getVoltages(), inputs[VOCT_INPUT].getChannels()};
+			VarTriSawCore::PolyInput aft = {inputs[AFTIN_INPUT].getVoltages(), inputs[AFTIN_INPUT].getChannels()};
+			VarTriSawCore::PolyInput gainIn = {inputs[GAININ_INPUT].getVoltages(), inputs[GAININ_INPUT].getChannels()};
+			channels = vartrisaw.process(voct, aft, gainIn, params[GAINPARAM_PARAM].getValue(), outputs[OUTSAW_OUTPUT].getVoltages(), outputs[OUTSQR_OUTPUT].getVoltages());
+		}
 		outputs[OUTSAW_OUTPUT].setChannels(channels);
 		outputs[OUTSQR_OUTPUT].setChannels(channels);
-		for(int i = 0; i < channels; i++) {
-			float freq = dsp::FREQ_C4 * powf(2.f, inputs[VOCT_INPUT].getPolyVoltage(std::min(OCTchannels, i)));
-			float pw = inputs[AFTIN_INPUT].getPolyVoltage(std::min(AFTchannels, i)) / 10.f;
-			gain = inputs[GAININ_INPUT].isConnected() ? 10.f - (10.f - inputs[GAININ_INPUT].getPolyVoltage(std::min(GAINchannels, i))) * params[GAINPARAM_PARAM].getValue() : 10.f;
-			SAWosc[i].SetFreq(freq);
-			SAWosc[i].SetPW((pw + 1.f) / 2.f);
-			SQRosc[i].SetFreq(freq);
-			SQRosc[i].SetPW( (pw * aft_amt[i] + 1.f) / 2.f );
-			outputs[OUTSAW_OUTPUT].setVoltage(SAWosc[i].Process() * gain, i);
-			outputs[OUTSQR_OUTPUT].setVoltage(SQRosc[i].Process() * gain, i);
+		processTimer.end(start, channels);
+	}
+
+	json_t* dataToJson() override {
+		json_t* rootJ = json_object();
+		json_object_set_new(rootJ, "cullHold", json_integer(cullHold));
+		json_object_set_new(rootJ, "engine", json_integer(vartrisaw.engine.load()));
+		json_object_set_new(rootJ, "unison", json_integer(unison));
+		json_object_set_new(rootJ, "unisonDetune", json_integer(unisonDetune));
+		json_object_set_new(rootJ, "unisonPwSpread", json_integer(unisonPwSpread));
+		return rootJ;
+	}
+
+	void dataFromJson(json_t* rootJ) override {
+		json_t* cullHoldJ = json_object_get(rootJ, "cullHold");
+		if (cullHoldJ) {
+			setCullHold(clamp((int)json_integer_value(cullHoldJ), 0, (int)LENGTHOF(CULL_HOLD_TIMES) - 1));
 		}
+		json_t* engineJ = json_object_get(rootJ, "engine");
+		if (engineJ) {
+			vartrisaw.setEngine(clamp((int)json_integer_value(engineJ), 0, VarTriSawCore::ENGINES_LEN - 1));
+		}
+		json_t* unisonJ = json_object_get(rootJ, "unison");
+		json_t* unisonDetuneJ = json_object_get(rootJ, "unisonDetune");
+		json_t* unisonPwSpreadJ = json_object_get(rootJ, "unisonPwSpread");
+		setUnison(unisonJ ? clamp((int)json_integer_value(unisonJ), 1, VarTriSawCore::MAX_UNISON) : 1,
+			unisonDetuneJ ? clamp((int)json_integer_value(unisonDetuneJ), 0, (int)LENGTHOF(UNISON_DETUNES) - 1) : 1,
+			unisonPwSpreadJ ? clamp((int)json_integer_value(unisonPwSpreadJ), 0, (int)LENGTHOF(UNISON_PW_SPREADS) - 1) : 0);
 	}
 };
 
+constexpr float VarTriSaw::CULL_HOLD_TIMES[];
+constexpr float VarTriSaw::UNISON_DETUNES[];
+constexpr float VarTriSaw::UNISON_PW_SPREADS[];
+
 
 struct VarTriSawWidget : ModuleWidget {
 	VarTriSawWidget(VarTriSaw* module) {
@@ -85,6 +141,38 @@ struct VarTriSawWidget : ModuleWidget {
 		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(9.939, 103.269)), module, VarTriSaw::OUTSAW_OUTPUT));
 		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(30.494, 103.108)), module, VarTriSaw::OUTSQR_OUTPUT));
 	}
+
+	void appendContextMenu(Menu* menu) override {
+		VarTriSaw* module = getModule<VarTriSaw>();
+
+		menu->addChild(new MenuSeparator);
+		if (module->busVoices > 0) {
+			menu->addChild(createMenuLabel(string::f("Playing %d voices from Polyfotz", module->busVoices)));
+		}
+		menu->addChild(createIndexSubmenuItem("Oscillator engine", {"polyBLEP", "Wavetable"},
+			[=]() {return module->vartrisaw.engine.load();},
+			[=](int i) {module->vartrisaw.setEngine(i);}
+		));
+		menu->addChild(createIndexSubmenuItem("Mute silent voices after", {"Never", "10 ms", "50 ms", "250 ms", "1 s"},
+			[=]() {return module->cullHold;},
+			[=](int i) {module->setCullHold(i);}
+		));
+		menu->addChild(createIndexSubmenuItem("Unison", {"Off", "2 oscillators", "3 oscillators", "4 oscillators", "5 oscillators", "6 oscillators", "7 oscillators", "8 oscillators"},
+			[=]() {return module->unison - 1;},
+			[=](int i) {module->setUnison(i + 1, module->unisonDetune, module->unisonPwSpread);}
+		));
+		menu->addChild(createIndexSubmenuItem("Unison detune", {"5 cents", "10 cents", "25 cents", "50 cents"},
+			[=]() {return module->unisonDetune;},
+			[=](int i) {module->setUnison(module->unison, i, module->unisonPwSpread);},
+			module->unison == 1
+		));
+		menu->addChild(createIndexSubmenuItem("Unison pulse width spread", {"Off", "5 %", "10 %", "20 %"},
+			[=]() {return module->unisonPwSpread;},
+			[=](int i) {module->setUnison(module->unison, module->unisonDetune, i);},
+			module->unison == 1
+		));
+		appendProcessTimerMenu(menu, module);
+	}
 };
 
 
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <cstring>
+
+/** Which build of the hot DSP kernels runs.
+ *
+ *  The plugin is compiled for Rack's baseline x86-64 target. On x86 with
+ *  GCC or Clang, the cores' entry points also get a twin marked
+ *  NB_TARGET_AVX2, which the compiler builds for AVX2 and FMA with
+ *  everything it calls inlined into it. The plugin's init() picks a level
+ *  once with select(), and the cores check level() on every call. Older
+ *  CPUs never reach the AVX2 code, so one binary runs everywhere.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define NB_CPU_DISPATCH 1
+#define NB_TARGET_AVX2 __attribute__((target("avx2,fma"), flatten))
+#else
+#define NB_CPU_DISPATCH 0
+#endif
+
+struct CpuDispatch {
+	enum Level {
+		BASELINE,
+		AVX2,
+		LEVELS_LEN
+	};
+
+	static const char* name(int level) {
+		static const char* names[LEVELS_LEN] = {"baseline", "avx2"};
+		return level >= 0 && level < LEVELS_LEN ? names[level] : "unknown";
+	}
+
+	/** The level for a name(), or -1.
+	 */
+	static int parse(const char* s) {
+		for (int level = 0; level < LEVELS_LEN; level++) {
+			if (std::strcmp(s, name(level)) == 0)
+				return level;
+		}
+		return -1;
+	}
+
+	/** The best level this CPU runs.
+	 */
+	static int detect() {
+#if NB_CPU_DISPATCH
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			return AVX2;
+#endif
+		return BASELINE;
+	}
+
+	/** Switches to level, or to the best one below it the CPU runs, and
+	 *  returns the level in use.
+	 */
+	static int select(int level) {
+		int best = detect();
+		level = level < BASELINE ? BASELINE : level > best ? best : level;
+		current().store(level, std::memory_order_relaxed);
+		return level;
+	}
+
+	static int level() {
+		return current().load(std::memory_order_relaxed);
+	}
+
+private:
+	// baseline until someone selects
+	static std::atomic<int>& current() {
+		static std::atomic<int> level(BASELINE);
+		return level;
+	}
+};
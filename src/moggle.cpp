@@ -1,7 +1,8 @@
 #include "plugin.hpp"
+#include "mogglecore.h"
 
 
-struct Moggle : Module {
+struct Moggle : TimedModule {
 	enum ParamId {
 		VAL1_PARAM,
 		VAL2_PARAM,
@@ -19,6 +20,13 @@ struct Moggle : Module {
 		LIGHTS_LEN
 	};
 
+	MoggleCore moggle;
+	// the snapshots as edited and saved, process() reads a published copy
+	MoggleSnapshots patchSnapshots;
+	// index into CONTROL_RATE_DIVIDERS
+	int controlRate = 0;
+	static constexpr int CONTROL_RATE_DIVIDERS[] = {1, 4, 16, 64};
+
 	Moggle() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
 		configParam(VAL1_PARAM, -10.f, 10.f, 0.f, "set value 1");
@@ -28,14 +36,100 @@ struct Moggle : Module {
 	}
 
 	void process(const ProcessArgs& args) override {
+        uint64_t start = processTimer.begin();
+        int channels = 0;
         if (outputs[CVOUT_OUTPUT].isConnected()) {
-            outputs[CVOUT_OUTPUT].setVoltage(
-                clamp(params[VAL1_PARAM].getValue() + (params[VAL2_PARAM].getValue() - params[VAL1_PARAM].getValue()) * (inputs[MORPHAMT_INPUT].getVoltage() / 10.f), -10.f, 10.f)
-            );
+            // one output channel per morph channel, unpatched morphs channel 1 by 0 V
+            channels = std::max(1, inputs[MORPHAMT_INPUT].getChannels());
+            outputs[CVOUT_OUTPUT].setChannels(channels);
+            moggle.process(params[VAL1_PARAM].getValue(), params[VAL2_PARAM].getValue(), inputs[MORPHAMT_INPUT].getVoltages(), channels, outputs[CVOUT_OUTPUT].getVoltages());
+        }
+        else {
+            // the output is cleared on unpatching, rewrite it on the next patch
+            moggle.dirty = true;
         }
+        processTimer.end(start, channels);
+	}
+
+	void setControlRate(int i) {
+		controlRate = i;
+		moggle.setDivider(CONTROL_RATE_DIVIDERS[i]);
+	}
+
+	/** UI thread. Sends the patch snapshots to process().
+	 */
+	void publishSnapshots() {
+		moggle.snapshots.publish(new MoggleSnapshots(patchSnapshots));
+	}
+
+	/** UI thread. Appends knob 1's value on every channel, overwritten by
+	 *  the current output on the channels the output carries when
+	 *  fromOutput is set.
+	 */
+	void addSnapshot(bool fromOutput) {
+		float values[MoggleSnapshots::MAX_CHANNELS];
+		int channels = fromOutput ? outputs[CVOUT_OUTPUT].getChannels() : 0;
+		for (int c = 0; c < MoggleSnapshots::MAX_CHANNELS; c++) {
+			values[c] = c < channels ? outputs[CVOUT_OUTPUT].getVoltage(c) : params[VAL1_PARAM].getValue();
+		}
+		if (patchSnapshots.add(values)) {
+			publishSnapshots();
+		}
+	}
+
+	void removeLastSnapshot() {
+		patchSnapshots.count = std::max(0, patchSnapshots.count - 1);
+		publishSnapshots();
+	}
+
+	void clearSnapshots() {
+		patchSnapshots.count = 0;
+		publishSnapshots();
+	}
+
+	json_t* dataToJson() override {
+		json_t* rootJ = json_object();
+		json_t* snapshotsJ = json_array();
+		for (int s = 0; s < patchSnapshots.count; s++) {
+			json_t* snapshotJ = json_array();
+			for (int c = 0; c < MoggleSnapshots::MAX_CHANNELS; c++) {
+				json_array_append_new(snapshotJ, json_real(patchSnapshots.values[s][c]));
+			}
+			json_array_append_new(snapshotsJ, snapshotJ);
+		}
+		json_object_set_new(rootJ, "snapshots", snapshotsJ);
+		json_object_set_new(rootJ, "controlRate", json_integer(controlRate));
+		return rootJ;
+	}
+
+	void dataFromJson(json_t* rootJ) override {
+		json_t* snapshotsJ = json_object_get(rootJ, "snapshots");
+		if (snapshotsJ) {
+			patchSnapshots.count = 0;
+			size_t i;
+			json_t* snapshotJ;
+			json_array_foreach(snapshotsJ, i, snapshotJ) {
+				int size = std::min((int)json_array_size(snapshotJ), (int)MoggleSnapshots::MAX_CHANNELS);
+				if (size == 0)
+					continue;
+				// channels past the end repeat the last value
+				float values[MoggleSnapshots::MAX_CHANNELS];
+				for (int c = 0; c < MoggleSnapshots::MAX_CHANNELS; c++) {
+					values[c] = clamp((float)json_number_value(json_array_get(snapshotJ, std::min(c, size - 1))), -10.f, 10.f);
+				}
+				patchSnapshots.add(values);
+			}
+			publishSnapshots();
+		}
+		json_t* controlRateJ = json_object_get(rootJ, "controlRate");
+		if (controlRateJ) {
+			setControlRate(clamp((int)json_integer_value(controlRateJ), 0, (int)LENGTHOF(CONTROL_RATE_DIVIDERS) - 1));
+		}
 	}
 };
 
+constexpr int Moggle::CONTROL_RATE_DIVIDERS[];
+
 
 struct MoggleWidget : ModuleWidget {
 	MoggleWidget(Moggle* module) {
@@ -54,6 +148,24 @@ struct MoggleWidget : ModuleWidget {
 
 		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(20.32, 102.37)), module, Moggle::CVOUT_OUTPUT));
 	}
+
+	void appendContextMenu(Menu* menu) override {
+		Moggle* module = getModule<Moggle>();
+
+		menu->addChild(new MenuSeparator);
+		int count = module->patchSnapshots.count;
+		bool full = count >= MoggleSnapshots::MAX_SNAPSHOTS;
+		menu->addChild(createMenuLabel(string::f("%d of %d snapshots between the knobs", count, MoggleSnapshots::MAX_SNAPSHOTS)));
+		menu->addChild(createMenuItem("Add knob 1 as snapshot", "", [=]() {module->addSnapshot(false);}, full));
+		menu->addChild(createMenuItem("Add outputs as snapshot", "", [=]() {module->addSnapshot(true);}, full));
+		menu->addChild(createMenuItem("Remove last snapshot", "", [=]() {module->removeLastSnapshot();}, count == 0));
+		menu->addChild(createMenuItem("Clear snapshots", "", [=]() {module->clearSnapshots();}, count == 0));
+		menu->addChild(createIndexSubmenuItem("Control rate", {"Audio rate", "1/4", "1/16", "1/64"},
+			[=]() {return module->controlRate;},
+			[=](int i) {module->setControlRate(i);}
+		));
+		appendProcessTimerMenu(menu, module);
+	}
 };
 
 
@@ -0,0 +1,152 @@
+#pragma once
+#include <math.hpp>
+#include <simd/functions.hpp>
+#include "objectswap.h"
+
+/** Moggle's snapshots: up to MAX_SNAPSHOTS points in order, each holding
+ *  one value per channel.
+ */
+struct MoggleSnapshots {
+	static const int MAX_SNAPSHOTS = 16;
+	static const int MAX_CHANNELS = 16;
+
+	float values[MAX_SNAPSHOTS][MAX_CHANNELS] = {};
+	int count = 0;
+
+	/** Appends a snapshot, or returns false when all are taken.
+	 */
+	bool add(const float* channelValues) {
+		if (count >= MAX_SNAPSHOTS)
+			return false;
+		for (int c = 0; c < MAX_CHANNELS; c++) {
+			values[count][c] = channelValues[c];
+		}
+		count++;
+		return true;
+	}
+};
+
+/** Moggle's morph, independent of the Rack engine so it can also run in
+ *  the headless tools.
+ *
+ *  Every channel morphs along the same ordered points: knob 1, the
+ *  snapshots in order, then knob 2, spread evenly over the 0..10 V morph
+ *  range. A channel's morph amount picks the segment between two points
+ *  and crossfades along it, reading both points' values for that channel.
+ *  Without snapshots this is the plain knob 1 to knob 2 morph.
+ *
+ *  The morph is evaluated every divider samples and the output ramps
+ *  linearly to each new value over the following divider samples. An
+ *  evaluation whose inputs all match the previous one is skipped, and
+ *  once the ramp has arrived the output buffer is left alone.
+ */
+struct MoggleCore {
+	typedef rack::simd::float_4 float_4;
+	static const int MAX_CHANNELS = MoggleSnapshots::MAX_CHANNELS;
+	static const int MAX_POINTS = MoggleSnapshots::MAX_SNAPSHOTS + 2;
+
+	// published by the module on the UI thread
+	ObjectSwap<MoggleSnapshots> snapshots;
+
+	// per point and channel, rebuilt when knobs or snapshots change
+	float points[MAX_POINTS][MAX_CHANNELS];
+	int pointCount = 2;
+	float lastKnob1 = 0.f, lastKnob2 = 0.f;
+	bool dirty = true;
+
+	// control rate: samples per evaluation, 1 is audio rate
+	int divider = 1;
+	int counter = 0;
+	bool ramping = false;
+	int lastChannels = 0;
+	float_4 lastMorph[MAX_CHANNELS / 4];
+	float_4 current[MAX_CHANNELS / 4];
+	float_4 target[MAX_CHANNELS / 4];
+	float_4 step[MAX_CHANNELS / 4];
+
+	MoggleCore() {
+		for (int i = 0; i < MAX_CHANNELS / 4; i++) {
+			lastMorph[i] = 0.f;
+			current[i] = 0.f;
+			target[i] = 0.f;
+			step[i] = 0.f;
+		}
+	}
+
+	void setDivider(int divider) {
+		this->divider = divider;
+		counter = 0;
+		dirty = true;
+	}
+
+	void updatePoints(float knob1, float knob2) {
+		const MoggleSnapshots& stored = *snapshots.active;
+		lastKnob1 = knob1;
+		lastKnob2 = knob2;
+		pointCount = stored.count + 2;
+		for (int c = 0; c < MAX_CHANNELS; c++) {
+			points[0][c] = knob1;
+			for (int s = 0; s < stored.count; s++) {
+				points[s + 1][c] = stored.values[s][c];
+			}
+			points[pointCount - 1][c] = knob2;
+		}
+		dirty = false;
+	}
+
+	/** Writes channels morphed values, in groups of four, into out, which
+	 *  has to be the same buffer every call. morph holds one 0..10 V
+	 *  amount per channel.
+	 */
+	void process(float knob1, float knob2, const float* morph, int channels, float* out) {
+		using namespace rack::simd;
+		if (snapshots.acquire()) {
+			dirty = true;
+		}
+		// setDivider() on the UI thread can zero the counter between the
+		// check and the decrement below
+		if (counter <= 0) {
+			counter = divider;
+			bool changed = dirty || knob1 != lastKnob1 || knob2 != lastKnob2 || channels != lastChannels;
+			for (int c = 0; c < channels; c += 4) {
+				float_4 m = float_4::load(morph + c);
+				changed |= movemask(m != lastMorph[c / 4]) != 0;
+				lastMorph[c / 4] = m;
+			}
+			if (changed) {
+				if (dirty || knob1 != lastKnob1 || knob2 != lastKnob2) {
+					updatePoints(knob1, knob2);
+				}
+				int segments = pointCount - 1;
+				for (int c = 0; c < channels; c += 4) {
+					float_4 position = clamp(lastMorph[c / 4] / 10.f, 0.f, 1.f) * (float)segments;
+					// 10 V is the end of the last segment, not the start of a next one
+					float_4 segment = fmin(floor(position), (float)(segments - 1));
+					float_4 from, to;
+					for (int j = 0; j < 4; j++) {
+						int s = (int)segment[j];
+						from[j] = points[s][c + j];
+						to[j] = points[s + 1][c + j];
+					}
+					target[c / 4] = clamp(from + (to - from) * (position - segment), -10.f, 10.f);
+					step[c / 4] = (target[c / 4] - current[c / 4]) / (float)divider;
+				}
+				// a new channel count has nothing to ramp from
+				if (channels != lastChannels) {
+					lastChannels = channels;
+					counter = 1;
+				}
+				ramping = true;
+			}
+		}
+		counter--;
+
+		if (ramping) {
+			for (int c = 0; c < channels; c += 4) {
+				current[c / 4] = counter <= 0 ? target[c / 4] : current[c / 4] + step[c / 4];
+				current[c / 4].store(out + c);
+			}
+			ramping = counter > 0;
+		}
+	}
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+
+/** Hands objects from the UI thread to the audio thread without locks or
+ *  allocation on the audio side.
+ *
+ *  publish() (UI thread) parks a new object in pending. acquire() (audio
+ *  thread) takes it and moves the object it replaces to retired, where the
+ *  next publish() or the destructor frees it. acquire() waits for retired
+ *  to be empty before taking an object, so each slot only ever has one
+ *  writer that fills it and one that empties it, and the audio thread
+ *  never frees memory.
+ *
+ *  publish() empties retired only after parking its object. Only an
+ *  acquire() that takes that object can refill retired afterwards, so an
+ *  object is never left pending behind a full retired slot that no later
+ *  publish() would clear.
+ */
+template <typename T>
+struct ObjectSwap {
+	T* active;
+	std::atomic<T*> pending;
+	std::atomic<T*> retired;
+
+	ObjectSwap() : active(new T), pending(nullptr), retired(nullptr) {}
+
+	~ObjectSwap() {
+		delete active;
+		delete pending.load();
+		delete retired.load();
+	}
+
+	ObjectSwap(const ObjectSwap&) = delete;
+	ObjectSwap& operator=(const ObjectSwap&) = delete;
+
+	/** UI thread. Takes ownership of object.
+	 */
+	void publish(T* object) {
+		// an object still pending was never seen by the audio thread
+		delete pending.exchange(object, std::memory_order_acq_rel);
+		delete retired.exchange(nullptr, std::memory_order_acquire);
+	}
+
+	/** Audio thread. Returns true when the active object changed.
+	 */
+	bool acquire() {
+		if (!pending.load(std::memory_order_relaxed) || retired.load(std::memory_order_relaxed))
+			return false;
+		T* object = pending.exchange(nullptr, std::memory_order_acquire);
+		if (!object)
+			return false;
+		retired.store(active, std::memory_order_release);
+		active = object;
+		return true;
+	}
+};
@@ -0,0 +1,206 @@
+#pragma once
+#include <simd/functions.hpp>
+
+/** Polyphase IIR half-band filters after Laurent de Soras' HIIR: two
+ *  parallel chains of first order allpass sections in z^-2. The
+ *  coefficients alternate between the two chains. T is float or
+ *  simd::float_4, in which case every lane is an independent channel.
+ */
+template <int NUM_COEFS, typename T = float>
+class HalfBandUpsampler
+{
+public:
+    void Init(const float* coefs)
+    {
+        coefs_ = coefs;
+        Reset();
+    }
+
+    void Reset()
+    {
+        for(int i = 0; i < NUM_COEFS; i++)
+        {
+            x_[i] = 0.f;
+            y_[i] = 0.f;
+        }
+    }
+
+    /** One sample in, two samples at twice the rate out.
+     */
+    void Process(T in, T& out0, T& out1)
+    {
+        T even = in;
+        T odd  = in;
+        ProcessAllpassPair(coefs_, x_, y_, NUM_COEFS, even, odd);
+        out0 = even;
+        out1 = odd;
+    }
+
+    static void ProcessAllpassPair(const float* coefs,
+                                   T*           x,
+                                   T*           y,
+                                   int          num_coefs,
+                                   T&           spl0,
+                                   T&           spl1)
+    {
+        int i = 0;
+        for(; i + 1 < num_coefs; i += 2)
+        {
+            T temp0  = (spl0 - y[i]) * coefs[i] + x[i];
+            T temp1  = (spl1 - y[i + 1]) * coefs[i + 1] + x[i + 1];
+            x[i]     = spl0;
+            x[i + 1] = spl1;
+            y[i]     = temp0;
+            y[i + 1] = temp1;
+            spl0     = temp0;
+            spl1     = temp1;
+        }
+        if(i < num_coefs)
+        {
+            T temp0 = (spl0 - y[i]) * coefs[i] + x[i];
+            x[i]    = spl0;
+            y[i]    = temp0;
+            spl0    = temp0;
+        }
+    }
+
+private:
+    const float* coefs_;
+    T            x_[NUM_COEFS];
+    T            y_[NUM_COEFS];
+};
+
+template <int NUM_COEFS, typename T = float>
+class HalfBandDownsampler
+{
+public:
+    void Init(const float* coefs)
+    {
+        coefs_ = coefs;
+        Reset();
+    }
+
+    void Reset()
+    {
+        for(int i = 0; i < NUM_COEFS; i++)
+        {
+            x_[i] = 0.f;
+            y_[i] = 0.f;
+        }
+    }
+
+    /** Two samples in, one sample at half the rate out.
+     */
+    T Process(T in0, T in1)
+    {
+        T spl0 = in1;
+        T spl1 = in0;
+        HalfBandUpsampler<NUM_COEFS, T>::ProcessAllpassPair(
+            coefs_, x_, y_, NUM_COEFS, spl0, spl1);
+        return 0.5f * (spl0 + spl1);
+    }
+
+private:
+    const float* coefs_;
+    T            x_[NUM_COEFS];
+    T            y_[NUM_COEFS];
+};
+
+/** Coefficients for the cascade in Oversampler. Each stage rejects images
+ *  and aliases of a 20 kHz band at 44.1 kHz base rate by at least 99 dB,
+ *  later stages get away with far fewer sections because the band of
+ *  interest gets narrower relative to their sample rate.
+ */
+static const float kHalfBandCoefs8[8] = {
+    0.040633461f, 0.150505129f, 0.300757056f, 0.460774505f,
+    0.609524315f, 0.738503841f, 0.849223810f, 0.949742784f};
+static const float kHalfBandCoefs4[4] = {
+    0.042454710f, 0.170739850f, 0.393319893f, 0.745713589f};
+static const float kHalfBandCoefs3[3] = {
+    0.057716366f, 0.248954523f, 0.652260665f};
+
+/** Runs a memoryless function at 2x, 4x or 8x the base rate through a
+ *  cascade of half-band up- and downsamplers.
+ */
+template <typename T = float>
+class Oversampler
+{
+public:
+    static const int kMaxStages = 3;
+
+    void Init()
+    {
+        up1_.Init(kHalfBandCoefs8);
+        up2_.Init(kHalfBandCoefs4);
+        up3_.Init(kHalfBandCoefs3);
+        down1_.Init(kHalfBandCoefs8);
+        down2_.Init(kHalfBandCoefs4);
+        down3_.Init(kHalfBandCoefs3);
+    }
+
+    void Reset()
+    {
+        up1_.Reset();
+        up2_.Reset();
+        up3_.Reset();
+        down1_.Reset();
+        down2_.Reset();
+        down3_.Reset();
+    }
+
+    /** Oversamples by 2^stages, applies shaper to every sample at the
+     *  higher rate and returns one sample at the base rate.
+     */
+    template <typename F>
+    T Process(T in, int stages, F shaper)
+    {
+        T   buffer[2][1 << kMaxStages];
+        int b = 0;
+        int n = 1;
+        buffer[b][0] = in;
+
+        for(int s = 0; s < stages; s++, n *= 2, b ^= 1)
+        {
+            for(int i = 0; i < n; i++)
+            {
+                T& out0 = buffer[b ^ 1][2 * i];
+                T& out1 = buffer[b ^ 1][2 * i + 1];
+                switch(s)
+                {
+                    case 0: up1_.Process(buffer[b][i], out0, out1); break;
+                    case 1: up2_.Process(buffer[b][i], out0, out1); break;
+                    default: up3_.Process(buffer[b][i], out0, out1); break;
+                }
+            }
+        }
+
+        for(int i = 0; i < n; i++)
+        {
+            buffer[b][i] = shaper(buffer[b][i]);
+        }
+
+        for(int s = stages - 1; s >= 0; s--, n /= 2, b ^= 1)
+        {
+            for(int i = 0; i < n / 2; i++)
+            {
+                T in0 = buffer[b][2 * i];
+                T in1 = buffer[b][2 * i + 1];
+                switch(s)
+                {
+                    case 0: buffer[b ^ 1][i] = down1_.Process(in0, in1); break;
+                    case 1: buffer[b ^ 1][i] = down2_.Process(in0, in1); break;
+                    default: buffer[b ^ 1][i] = down3_.Process(in0, in1); break;
+                }
+            }
+        }
+        return buffer[b][0];
+    }
+
+private:
+    HalfBandUpsampler<8, T>   up1_;
+    HalfBandUpsampler<4, T>   up2_;
+    HalfBandUpsampler<3, T>   up3_;
+    HalfBandDownsampler<8, T> down1_;
+    HalfBandDownsampler<4, T> down2_;
+    HalfBandDownsampler<3, T> down3_;
+};
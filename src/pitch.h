@@ -0,0 +1,68 @@
+#pragma once
+#include <cstring>
+#include <simd/functions.hpp>
+#include <dsp/common.hpp>
+
+/** 2^(j / 16) for the table part of exp2Fast().
+ */
+static const float kExp2Table[16] = {
+    1.000000000f, 1.044273782f, 1.090507733f, 1.138788635f,
+    1.189207115f, 1.241857812f, 1.296839555f, 1.354255547f,
+    1.414213562f, 1.476826146f, 1.542210825f, 1.610490332f,
+    1.681792831f, 1.756252160f, 1.834008086f, 1.915206561f};
+
+/** 2^x split into 2^n * 2^(j / 16) * 2^r with r in [0, 1 / 16]. 2^n goes
+ *  straight into the exponent bits, 2^(j / 16) comes from kExp2Table and
+ *  2^r from a cubic. x - floor(x) can round up to 1, so j stops at 15.
+ *  Relative error is below 3e-7, about 0.0005 cent. Valid for x in
+ *  [-126, 127].
+ */
+inline float exp2Fast(float x)
+{
+    float   n = std::floor(x);
+    float   f = (x - n) * 16.f;
+    float   j = std::fmin(std::floor(f), 15.f);
+    float   r = (f - j) * (1.f / 16.f);
+    float   p = 1.f + r * (0.693147181f + r * (0.240226507f + r * 0.0555041087f));
+    int32_t e = ((int32_t)n + 127) << 23;
+    float   scale;
+    std::memcpy(&scale, &e, sizeof(scale));
+    return scale * kExp2Table[(int)j] * p;
+}
+
+inline rack::simd::float_4 exp2Fast(rack::simd::float_4 x)
+{
+    using namespace rack::simd;
+    float_4 n = floor(x);
+    float_4 f = (x - n) * 16.f;
+    float_4 j = fmin(floor(f), 15.f);
+    float_4 r = (f - j) * (1.f / 16.f);
+    float_4 p = 1.f + r * (0.693147181f + r * (0.240226507f + r * 0.0555041087f));
+    float_4 scale = float_4::cast((int32_4(n) + int32_4(127)) << 23);
+    int32_4 index = int32_4(j);
+    float_4 table(kExp2Table[index[0]], kExp2Table[index[1]],
+                  kExp2Table[index[2]], kExp2Table[index[3]]);
+    return scale * table * p;
+}
+
+/** V/Oct to oscillator phase increments in cycles per sample, 0 V is C4.
+ *  The reciprocal sample rate is folded into the C4 frequency, so every
+ *  conversion is one exp2Fast() and one multiply.
+ */
+class PitchConverter
+{
+public:
+    void Init(float sample_rate)
+    {
+        c4_increment_ = rack::dsp::FREQ_C4 / sample_rate;
+    }
+
+    template <typename T>
+    T PhaseIncrement(T voct)
+    {
+        return c4_increment_ * exp2Fast(voct);
+    }
+
+private:
+    float c4_increment_;
+};
@@ -1,4 +1,6 @@
 #include "plugin.hpp"
+#include "cpudispatch.h"
+#include <cstdlib>
 
 
 Plugin* pluginInstance;
@@ -14,6 +16,67 @@ void init(Plugin* p) {
     p->addModel(modelPolyfotz);
     p->addModel(modelVarTriSaw);
 
+	// start the cycle counter calibration, see ProcessTimer::ticksToNs()
+	ProcessTimer::ticksToNs();
+
+	// the fastest DSP kernels this CPU runs, NB_CPU=baseline forces the
+	// baseline ones for testing
+	const char* cpu = std::getenv("NB_CPU");
+	int level = cpu ? CpuDispatch::parse(cpu) : -1;
+	level = CpuDispatch::select(level >= 0 ? level : CpuDispatch::detect());
+	INFO("NB DSP kernels: %s", CpuDispatch::name(level));
+
 	// Any other plugin initialization may go here.
 	// As an alternative, consider lazy-loading assets and lookup tables when your module is created to reduce startup times of Rack.
 }
+
+
+static json_t* processTimerToJson(TimedModule* module) {
+	ProcessTimer::Stats stats = module->processTimer.stats();
+	json_t* timerJ = json_object();
+	json_object_set_new(timerJ, "id", json_integer(module->id));
+	json_object_set_new(timerJ, "model", json_string(module->model->slug.c_str()));
+	json_object_set_new(timerJ, "enabled", json_boolean(module->processTimer.enabled));
+	json_object_set_new(timerJ, "calls", json_integer(stats.calls));
+	json_object_set_new(timerJ, "averageNs", json_real(stats.averageNs));
+	json_object_set_new(timerJ, "p99Ns", json_real(stats.p99Ns));
+	json_object_set_new(timerJ, "worstNs", json_real(stats.worstNs));
+	json_object_set_new(timerJ, "channels", json_integer(stats.channels));
+	return timerJ;
+}
+
+// every module of this plugin in the patch, as a JSON array on the clipboard
+static void copyProcessTimerReport() {
+	json_t* reportJ = json_array();
+	for (int64_t id : APP->engine->getModuleIds()) {
+		TimedModule* module = dynamic_cast<TimedModule*>(APP->engine->getModule(id));
+		if (module && module->model->plugin == pluginInstance) {
+			json_array_append_new(reportJ, processTimerToJson(module));
+		}
+	}
+	char* report = json_dumps(reportJ, JSON_INDENT(2));
+	json_decref(reportJ);
+	if (report) {
+		glfwSetClipboardString(APP->window->win, report);
+		free(report);
+	}
+}
+
+void appendProcessTimerMenu(Menu* menu, TimedModule* module) {
+	menu->addChild(createSubmenuItem("Process timing", module->processTimer.enabled ? "On" : "", [=](Menu* menu) {
+		menu->addChild(createBoolMenuItem("Time process() calls", "",
+			[=]() {return module->processTimer.enabled.load();},
+			[=](bool enabled) {module->processTimer.enabled = enabled;}
+		));
+		ProcessTimer::Stats stats = module->processTimer.stats();
+		if (stats.calls > 0) {
+			menu->addChild(createMenuLabel(string::f("Average: %.0f ns", stats.averageNs)));
+			menu->addChild(createMenuLabel(string::f("p99: %.0f ns", stats.p99Ns)));
+			menu->addChild(createMenuLabel(string::f("Worst: %.0f ns", stats.worstNs)));
+			menu->addChild(createMenuLabel(string::f("Channels: %d", stats.channels)));
+			menu->addChild(createMenuLabel(string::f("Timed calls: %llu", (unsigned long long) stats.calls)));
+		}
+		menu->addChild(createMenuItem("Reset", "", [=]() {module->processTimer.reset();}));
+		menu->addChild(createMenuItem("Copy report for all NB modules as JSON", "", copyProcessTimerReport));
+	}));
+}
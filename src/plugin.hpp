@@ -1,5 +1,6 @@
 #pragma once
 #include <rack.hpp>
+#include "processtimer.h"
 
 
 using namespace rack;
@@ -13,3 +14,11 @@ extern Model* modelSoftclip;
 extern Model* modelMoggle;
 extern Model* modelPolyfotz;
 extern Model* modelVarTriSaw;
+
+// Base of every module in the plugin, times process() on request
+struct TimedModule : Module {
+	ProcessTimer processTimer;
+};
+
+// Adds the "Process timing" submenu to a module's context menu
+void appendProcessTimerMenu(Menu* menu, TimedModule* module);
@@ -1,7 +1,9 @@
 #include "plugin.hpp"
+#include "polyfotzcore.h"
+#include <osdialog.h>
 
 
-struct Polyfotz : Module {
+struct Polyfotz : TimedModule {
 	enum ParamId {
 		TRANSP_PARAM,
 		TUNE_PARAM,
@@ -29,24 +31,12 @@ struct Polyfotz : Module {
 		LIGHTS_LEN
 	};
 
-	float freq = 440.f;
-	float tune, aft_param, aft_raw, bendfactor, transp, spread, pitchwheel = 0.f;
-	float bendrange = 2.f;
-	float octave = 1.f;
-	int voicing_select = 0;
-	float aft_amt[4] = { .6f, .3f, .7f, .8f };
-	float detune_amt[4] = { 0.f, -0.1f / 12.f, 0.1f / 12.f, -0.2f / 12.f };
-	std::vector<std::vector<int>> voicings = { {0, -5, -10, -12},
-							{0, -5, -10, -20},
-							{0, -3, -8, -19},
-							{0, -3, -7, -10},
-							{0, -4, -9, -11},
-							{0, -3, -8, -11},
-							{0, -5, -7, -11},
-							{0, -5, -11, -15},
-							{0, -3, -6, -9},
-							{0, -4, -8, -12},
-							};
+	PolyfotzCore polyfotz;
+	// harmonize every channel of the V/Oct input instead of only the first
+	bool polyInput = false;
+	// UI thread copies of what the audio thread's bank is built from
+	VoicingBank patchVoicings;
+	std::shared_ptr<const VoicingLibrary> library;
 
 	Polyfotz() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
@@ -55,6 +45,8 @@ struct Polyfotz : Module {
 		configParam(DETUNE_PARAM, 0.f, 1.f, 0.f, "detune spread");
 		configParam(OCT_SEL_CV_PARAM, -2.f, 2.f, 0.f, "transpose by octave");
 		configParam(VOICING_SEL_PARAM, 0.f, 12.f, 0.f, "voicing selection");
+		// steps through the patch voicings, sweeps a loaded library, see loadLibrary()
+		paramQuantities[VOICING_SEL_PARAM]->snapEnabled = true;
 		configParam(AFT_RAND_PARAM, 0.f, 1.f, .5f, "aftertouch randomization");
 		configInput(CVIN_INPUT, "V/OCT");
 		configInput(OCTCVIN_INPUT, "toggle transpose by octave");
@@ -64,46 +56,120 @@ struct Polyfotz : Module {
 		configOutput(POLY_OUT_OUTPUT, "polyphonic");
 		configOutput(AFT_OUT_OUTPUT, "polyphonic aftertouch");
 		configOutput(GAIN_OUT_OUTPUT, "polyphonic gain");
+		polyfotz.setSampleRate(APP->engine->getSampleRate());
+	}
+
+	void onSampleRateChange(const SampleRateChangeEvent& e) override {
+		polyfotz.setSampleRate(e.sampleRate);
 	}
 
 	void process(const ProcessArgs& args) override {
-		tune = params[TUNE_PARAM].getValue();
-		aft_raw = inputs[AFTCV_INPUT].isConnected() ? inputs[AFTCV_INPUT].getVoltage() : 10.f;
-		aft_param = params[AFT_RAND_PARAM].getValue();
-		octave = inputs[OCTCVIN_INPUT].isConnected() ? params[OCT_SEL_CV_PARAM].getValue() * (int)(inputs[OCTCVIN_INPUT].getVoltage() / 10.f) : params[OCT_SEL_CV_PARAM].getValue();
-		pitchwheel = inputs[PW_CV_INPUT].getVoltage() / 5.f;
-		bendfactor = (pitchwheel * bendrange) / 12.f;
-		transp = params[TRANSP_PARAM].getValue() / 12.f;
-		spread = params[DETUNE_PARAM].getValue() / .9f + .1f;
-		freq = inputs[CVIN_INPUT].getVoltage() + octave + transp + tune;
-		voicing_select = inputs[VOICINGCV_INPUT].isConnected() ? ((int)abs(floor(inputs[VOICINGCV_INPUT].getVoltage())) % voicings.size()) : (int)(params[VOICING_SEL_PARAM].getValue()) % voicings.size();
-		int channels = bendfactor < 0.f ? voicings[voicing_select].size() : 4;
+		uint64_t start = processTimer.begin();
+		PolyfotzCore::Controls controls;
+		controls.notes = polyInput ? PolyfotzCore::clampNotes(inputs[CVIN_INPUT].getChannels()) : 1;
+		for (int n = 0; n < controls.notes; n++) {
+			controls.cv[n] = inputs[CVIN_INPUT].getVoltage(n);
+			controls.aft[n] = inputs[AFTCV_INPUT].isConnected() ? inputs[AFTCV_INPUT].getPolyVoltage(n) : 10.f;
+		}
+		controls.octIn = inputs[OCTCVIN_INPUT].isConnected() ? inputs[OCTCVIN_INPUT].getVoltage() : 10.f;
+		controls.pitchwheelIn = inputs[PW_CV_INPUT].getVoltage();
+		controls.voicingCv = inputs[VOICINGCV_INPUT].isConnected();
+		controls.voicingIn = controls.voicingCv ? inputs[VOICINGCV_INPUT].getVoltage() : params[VOICING_SEL_PARAM].getValue();
+		controls.transpParam = params[TRANSP_PARAM].getValue();
+		controls.tuneParam = params[TUNE_PARAM].getValue();
+		controls.detuneParam = params[DETUNE_PARAM].getValue();
+		controls.octParam = params[OCT_SEL_CV_PARAM].getValue();
+		controls.aftParam = params[AFT_RAND_PARAM].getValue();
+		int channels = polyfotz.process(controls, outputs[POLY_OUT_OUTPUT].getVoltages(), outputs[AFT_OUT_OUTPUT].getVoltages(), outputs[GAIN_OUT_OUTPUT].getVoltages());
 		outputs[POLY_OUT_OUTPUT].setChannels(channels);
 		outputs[AFT_OUT_OUTPUT].setChannels(channels);
 		outputs[GAIN_OUT_OUTPUT].setChannels(channels);
-		for (int i = 0; i < channels; i++) {
-			float aftVolt = (aft_raw * powf(aft_amt[i % 3], aft_param));
-			float polyVolt = freq + (detune_amt[i % 3] * spread) + (bendfactor < 0.f ? (float)voicings[voicing_select][i] / -12.f * pitchwheel : bendfactor);
-			outputs[POLY_OUT_OUTPUT].setVoltage(polyVolt, i);
-			outputs[AFT_OUT_OUTPUT].setVoltage(aftVolt, i);
-			outputs[GAIN_OUT_OUTPUT].setVoltage(10.f - (float)i / (float)channels * 10.f, i);
+		// a VarTriSaw to the right gets every voice without cables, see voicebus.h
+		Module* right = getRightExpander().module;
+		if (right && right->model == modelVarTriSaw) {
+			polyfotz.processBus((VoiceBusMessage*) right->getLeftExpander().producerMessage);
+			right->getLeftExpander().requestMessageFlip();
+		}
+		processTimer.end(start, channels);
+	}
+
+	/** UI thread. Sends the patch voicings and the library to process().
+	 */
+	void publishVoicings() {
+		VoicingBank* bank = new VoicingBank(patchVoicings);
+		bank->library = library;
+		polyfotz.voicings.publish(bank);
+	}
+
+	/** UI thread. An empty path unloads the library. While a library is
+	 *  loaded the voicing knob turns freely, so its 0..12 range reaches
+	 *  every voicing of the library rather than only 13 of them.
+	 */
+	bool loadLibrary(const std::string& path, std::string* error = NULL) {
+		if (!setLibrary(path, error))
+			return false;
+		publishVoicings();
+		return true;
+	}
+
+	/** UI thread. loadLibrary() without publishing. Keeps the current
+	 *  library when path fails to open.
+	 */
+	bool setLibrary(const std::string& path, std::string* error = NULL) {
+		std::shared_ptr<const VoicingLibrary> loaded;
+		if (!path.empty()) {
+			loaded = VoicingLibrary::open(path, error);
+			if (!loaded)
+				return false;
 		}
+		library = loaded;
+		ParamQuantity* voicingQuantity = paramQuantities[VOICING_SEL_PARAM];
+		voicingQuantity->snapEnabled = !library;
+		if (!library) {
+			voicingQuantity->setValue(std::round(voicingQuantity->getValue()));
+		}
+		return true;
+	}
+
+	json_t* dataToJson() override {
+		json_t* rootJ = json_object();
+		json_object_set_new(rootJ, "polyInput", json_boolean(polyInput));
+		if (library) {
+			json_object_set_new(rootJ, "voicingLibrary", json_string(library->path().c_str()));
+		}
+		return rootJ;
 	}
 
 	void dataFromJson(json_t* rootJ) override {
+		json_t* polyInputJ = json_object_get(rootJ, "polyInput");
+		if (polyInputJ) {
+			polyInput = json_boolean_value(polyInputJ);
+		}
 		json_t* voicingsJ = json_object_get(rootJ, "voicings");
-		if (voicingsJ) {
-			voicings.resize(json_array_size(voicingsJ));
-			for (int i = 0; i < voicings.size(); i++) {
-				json_t* voicingJ = json_array_get(voicingsJ, i);
-				if (voicingJ) {
-					voicings[i].resize(json_array_size(voicingJ));
-					for (int j = 0; j < voicings[i].size(); j++) {
-						voicings[i][j] = json_integer_value(json_array_get(voicingJ, j));
-					}
+		if (voicingsJ && json_array_size(voicingsJ) > 0) {
+			// parsed here on the UI thread, process() only swaps the pointer
+			patchVoicings.clear();
+			size_t i;
+			json_t* voicingJ;
+			json_array_foreach(voicingsJ, i, voicingJ) {
+				int voices[VoicingBank::MAX_VOICES];
+				int size = std::min((int)json_array_size(voicingJ), (int)VoicingBank::MAX_VOICES);
+				for (int j = 0; j < size; j++) {
+					voices[j] = json_integer_value(json_array_get(voicingJ, j));
 				}
+				if (!patchVoicings.add(voices, size))
+					break;
 			}
 		}
+		json_t* libraryJ = json_object_get(rootJ, "voicingLibrary");
+		const char* libraryPath = libraryJ ? json_string_value(libraryJ) : NULL;
+		std::string error;
+		if (!setLibrary(libraryPath ? libraryPath : "", &error)) {
+			WARN("%s", error.c_str());
+			setLibrary("");
+		}
+		// once, whatever was loaded, so process() sees a single swap
+		publishVoicings();
 	}
 };
 
@@ -123,7 +189,7 @@ struct PolyfotzWidget : ModuleWidget {
 		addParam(createParamCentered<Trimpot>(mm2px(Vec(33.407, 55.733)), module, Polyfotz::DETUNE_PARAM));
 		addParam(createParamCentered<RoundBlackSnapKnob>(mm2px(Vec(22.285, 56.891)), module, Polyfotz::OCT_SEL_CV_PARAM));
 		addParam(createParamCentered<Trimpot>(mm2px(Vec(21.166, 73.538)), module, Polyfotz::AFT_RAND_PARAM));
-		addParam(createParamCentered<RoundBlackSnapKnob>(mm2px(Vec(24.616, 93.301)), module, Polyfotz::VOICING_SEL_PARAM));
+		addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(24.616, 93.301)), module, Polyfotz::VOICING_SEL_PARAM));
 
 		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(10.832, 39.774)), module, Polyfotz::CVIN_INPUT));
 		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(8.352, 56.188)), module, Polyfotz::OCTCVIN_INPUT));
@@ -135,6 +201,27 @@ struct PolyfotzWidget : ModuleWidget {
 		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(36.218, 101.709)), module, Polyfotz::GAIN_OUT_OUTPUT));
 		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(30.829, 112.63)), module, Polyfotz::POLY_OUT_OUTPUT));
 	}
+
+	void appendContextMenu(Menu* menu) override {
+		Polyfotz* module = getModule<Polyfotz>();
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createBoolPtrMenuItem("Polyphonic input", "", &module->polyInput));
+		menu->addChild(createMenuItem("Load voicing library...", module->library ? system::getFilename(module->library->path()) : "", [=]() {
+			osdialog_filters* filters = osdialog_filters_parse("Voicing library (.nbvl):nbvl");
+			char* path = osdialog_file(OSDIALOG_OPEN, NULL, NULL, filters);
+			osdialog_filters_free(filters);
+			if (!path)
+				return;
+			std::string error;
+			if (!module->loadLibrary(path, &error)) {
+				osdialog_message(OSDIALOG_WARNING, OSDIALOG_OK, error.c_str());
+			}
+			std::free(path);
+		}));
+		menu->addChild(createMenuItem("Unload voicing library", "", [=]() {module->loadLibrary("");}, !module->library));
+		appendProcessTimerMenu(menu, module);
+	}
 };
 
 
@@ -0,0 +1,249 @@
+#pragma once
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <simd/functions.hpp>
+#include "voicingbank.h"
+#include "voicebus.h"
+#include "pitch.h"
+
+/** Polyfotz's voice generator, independent of the Rack engine so it can
+ *  also run in the headless tools.
+ */
+struct PolyfotzCore {
+	typedef rack::simd::float_4 float_4;
+	static const int MAX_CHANNELS = 16;
+	// notes harmonized at once in polyphonic input mode
+	static const int MAX_NOTES = 4;
+	// every voice of every note, for the expander bus
+	static const int MAX_BUS_VOICES = MAX_NOTES * MAX_CHANNELS;
+	static_assert(MAX_BUS_VOICES <= VoiceBusMessage::MAX_VOICES, "the bus must fit every voice");
+
+	/** Everything process() reads, gathered once per sample by the module.
+	 */
+	struct Controls {
+		// V/Oct and aftertouch per input note
+		float cv[MAX_NOTES] = {};
+		// 10 V when the aftertouch input is unpatched
+		float aft[MAX_NOTES] = { 10.f, 10.f, 10.f, 10.f };
+		int notes = 1;
+		// 10 V when the octave toggle input is unpatched
+		float octIn = 10.f;
+		float pitchwheelIn = 0.f;
+		// voicing cv, or the voicing knob when voicingCv is false
+		float voicingIn = 0.f;
+		bool voicingCv = false;
+		float transpParam = 0.f;
+		float tuneParam = 0.f;
+		float detuneParam = 0.f;
+		float octParam = 0.f;
+		float aftParam = .5f;
+	};
+
+	float freq = 440.f;
+	float tune, aft_param, aft_raw, bendfactor, transp, spread, pitchwheel = 0.f;
+	float bendrange = 2.f;
+	float octave = 1.f;
+	int voicing_select = 0;
+	float aft_amt[4] = { .6f, .3f, .7f, .8f };
+	float detune_amt[4] = { 0.f, -0.1f / 12.f, 0.1f / 12.f, -0.2f / 12.f };
+	// swapped in from the UI thread by the module's dataFromJson()
+	VoicingBankSwap voicings;
+
+	// per voice tables, only recomputed when the controls they depend on change
+	float voiceOffset[MAX_CHANNELS] = {};
+	float voiceAft[MAX_CHANNELS] = {};
+	float voiceGain[MAX_CHANNELS] = {};
+	float pitchOffset = 0.f;
+	// voices per note
+	int channels = 4;
+
+	// the voice tables repeated once per note, laid out like the outputs
+	float_4 layoutOffset[MAX_CHANNELS / 4];
+	float_4 layoutAft[MAX_CHANNELS / 4];
+	float_4 layoutGain[MAX_CHANNELS / 4];
+	int layoutNote[MAX_CHANNELS] = {};
+	int notes = 1;
+	int outChannels = 4;
+	// the same without the cables' channel limit
+	float_4 busOffset[MAX_BUS_VOICES / 4];
+	float_4 busAft[MAX_BUS_VOICES / 4];
+	float_4 busGain[MAX_BUS_VOICES / 4];
+	int busNote[MAX_BUS_VOICES] = {};
+	int busVoices = 4;
+	// the notes of the last process() call, for processBus()
+	float noteFreqs[MAX_NOTES] = {};
+	float noteAfts[MAX_NOTES] = {};
+	PitchConverter pitch;
+	bool dirty = true;
+	float lastPitchwheelIn = 0.f, lastDetuneParam = 0.f, lastVoicingIn = 0.f, lastOctParam = 0.f, lastOctIn = 0.f, lastTranspParam = 0.f, lastTuneParam = 0.f;
+	bool lastVoicingCv = false;
+
+	PolyfotzCore() {
+		for (int i = 0; i < MAX_BUS_VOICES / 4; i++) {
+			busOffset[i] = busAft[i] = busGain[i] = 0.f;
+		}
+		setSampleRate(44100.f);
+	}
+
+	void setSampleRate(float sampleRate) {
+		pitch.Init(sampleRate);
+	}
+
+	void updateVoiceOffsets(float pitchwheelIn, float detuneParam, float voicingIn, bool voicingCv) {
+		pitchwheel = pitchwheelIn / 5.f;
+		bendfactor = (pitchwheel * bendrange) / 12.f;
+		spread = detuneParam / .9f + .1f;
+		const VoicingBank& bank = *voicings.active;
+		int count = bank.voicings();
+		if (bank.library) {
+			// the knob's 0..12 or the cv's 0..10 V span the whole library
+			float position = voicingCv ? std::max(0.f, std::min(voicingIn / 10.f, 1.f)) : voicingIn / 12.f;
+			voicing_select = std::min((int)(position * count), count - 1);
+		}
+		else {
+			voicing_select = voicingCv ? ((int)abs(floor(voicingIn)) % count) : (int)(voicingIn) % count;
+		}
+		channels = bendfactor < 0.f ? std::min(bank.size(voicing_select), (int)MAX_CHANNELS) : 4;
+		for (int i = 0; i < channels; i++) {
+			voiceOffset[i] = (detune_amt[i % 3] * spread) + (bendfactor < 0.f ? (float)bank.offset(voicing_select, i) / -12.f * pitchwheel : bendfactor);
+			voiceGain[i] = 10.f - (float)i / (float)channels * 10.f;
+		}
+		// the aftertouch table follows the channel count
+		updateVoiceAft(aft_param);
+	}
+
+	void updateVoiceAft(float aftParam) {
+		aft_param = aftParam;
+		for (int i = 0; i < channels; i++) {
+			voiceAft[i] = powf(aft_amt[i % 3], aft_param);
+		}
+		updateLayout();
+	}
+
+	/** Fans the voice tables out to every note. With more notes than fit,
+	 *  each note keeps its first MAX_CHANNELS / notes voices.
+	 */
+	void updateLayout() {
+		int voices = std::min(channels, MAX_CHANNELS / notes);
+		outChannels = voices * notes;
+		for (int c = 0, note = 0, voice = 0; c < outChannels; c++) {
+			layoutNote[c] = note;
+			layoutOffset[c / 4][c % 4] = voiceOffset[voice];
+			layoutAft[c / 4][c % 4] = voiceAft[voice];
+			layoutGain[c / 4][c % 4] = voiceGain[voice];
+			if (++voice == voices) {
+				voice = 0;
+				note++;
+			}
+		}
+		// the last group is stored whole, keep its unused lanes on note 0
+		for (int c = outChannels; c < MAX_CHANNELS; c++) {
+			layoutNote[c] = 0;
+		}
+
+		busVoices = channels * notes;
+		for (int c = 0, note = 0, voice = 0; c < busVoices; c++) {
+			busNote[c] = note;
+			busOffset[c / 4][c % 4] = voiceOffset[voice];
+			busAft[c / 4][c % 4] = voiceAft[voice];
+			busGain[c / 4][c % 4] = voiceGain[voice];
+			if (++voice == channels) {
+				voice = 0;
+				note++;
+			}
+		}
+		for (int c = busVoices; c < MAX_BUS_VOICES; c++) {
+			busNote[c] = 0;
+		}
+	}
+
+	static int clampNotes(int n) {
+		return std::max(1, std::min(n, (int)MAX_NOTES));
+	}
+
+	/** Writes one sample of pitch, aftertouch and gain per voice and returns
+	 *  the number of voices. Outputs are written in groups of four.
+	 */
+	int process(const Controls& in, float* polyOut, float* aftOut, float* gainOut) {
+		if (voicings.acquire()) {
+			dirty = true;
+		}
+		int inNotes = clampNotes(in.notes);
+
+		if (dirty || in.pitchwheelIn != lastPitchwheelIn || in.detuneParam != lastDetuneParam || in.voicingIn != lastVoicingIn || in.voicingCv != lastVoicingCv) {
+			lastPitchwheelIn = in.pitchwheelIn;
+			lastDetuneParam = in.detuneParam;
+			lastVoicingIn = in.voicingIn;
+			lastVoicingCv = in.voicingCv;
+			aft_param = in.aftParam;
+			notes = inNotes;
+			updateVoiceOffsets(in.pitchwheelIn, in.detuneParam, in.voicingIn, in.voicingCv);
+		}
+		else if (in.aftParam != aft_param) {
+			notes = inNotes;
+			updateVoiceAft(in.aftParam);
+		}
+		else if (inNotes != notes) {
+			notes = inNotes;
+			updateLayout();
+		}
+
+		if (dirty || in.octParam != lastOctParam || in.octIn != lastOctIn || in.transpParam != lastTranspParam || in.tuneParam != lastTuneParam) {
+			lastOctParam = in.octParam;
+			lastOctIn = in.octIn;
+			lastTranspParam = in.transpParam;
+			lastTuneParam = in.tuneParam;
+			octave = in.octParam * (int)(in.octIn / 10.f);
+			transp = in.transpParam / 12.f;
+			tune = in.tuneParam;
+			pitchOffset = octave + transp + tune;
+		}
+		dirty = false;
+
+		for (int n = 0; n < notes; n++) {
+			noteFreqs[n] = in.cv[n] + pitchOffset;
+			noteAfts[n] = in.aft[n];
+		}
+		freq = noteFreqs[0];
+		aft_raw = in.aft[0];
+		for (int c = 0; c < outChannels; c += 4) {
+			float_4 noteFreq, noteAft;
+			if (notes == 1) {
+				noteFreq = freq;
+				noteAft = aft_raw;
+			}
+			else {
+				const int* note = layoutNote + c;
+				noteFreq = float_4(noteFreqs[note[0]], noteFreqs[note[1]], noteFreqs[note[2]], noteFreqs[note[3]]);
+				noteAft = float_4(in.aft[note[0]], in.aft[note[1]], in.aft[note[2]], in.aft[note[3]]);
+			}
+			(noteFreq + layoutOffset[c / 4]).store(polyOut + c);
+			(noteAft * layoutAft[c / 4]).store(aftOut + c);
+			layoutGain[c / 4].store(gainOut + c);
+		}
+		return outChannels;
+	}
+
+	/** Writes the voices of the last process() call to bus, every voice of
+	 *  every note and with the pitch converted to phase increments.
+	 */
+	void processBus(VoiceBusMessage* bus) {
+		bus->voices = busVoices;
+		for (int c = 0; c < busVoices; c += 4) {
+			float_4 noteFreq, noteAft;
+			if (notes == 1) {
+				noteFreq = freq;
+				noteAft = aft_raw;
+			}
+			else {
+				const int* note = busNote + c;
+				noteFreq = float_4(noteFreqs[note[0]], noteFreqs[note[1]], noteFreqs[note[2]], noteFreqs[note[3]]);
+				noteAft = float_4(noteAfts[note[0]], noteAfts[note[1]], noteAfts[note[2]], noteAfts[note[3]]);
+			}
+			bus->phaseIncrement[c / 4] = pitch.PhaseIncrement(noteFreq + busOffset[c / 4]);
+			bus->pwm[c / 4] = noteAft * busAft[c / 4] / 10.f;
+			bus->gain[c / 4] = busGain[c / 4];
+		}
+	}
+};
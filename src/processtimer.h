@@ -0,0 +1,171 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/** Sampled timing of a module's process() calls, independent of the Rack
+ *  engine.
+ *
+ *  While enabled, every SAMPLE_INTERVAL-th call is timed with the CPU's
+ *  cycle counter and sorted into a histogram with eight buckets per
+ *  octave, so p99 is accurate to about 10 %. Only the audio thread writes
+ *  the counters, the UI thread reads them through stats() and asks for a
+ *  reset through reset(). Nothing here allocates or locks.
+ */
+struct ProcessTimer {
+	static const int SAMPLE_INTERVAL = 16;
+	static const int SUB_BUCKETS = 8;
+	static const int BUCKETS = (64 - 2) * SUB_BUCKETS;
+
+	struct Stats {
+		uint64_t calls;
+		double averageNs;
+		double p99Ns;
+		double worstNs;
+		int channels;
+	};
+
+	std::atomic<bool> enabled;
+
+	ProcessTimer() : enabled(false), resetRequested(false) {
+		clear();
+	}
+
+	static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#elif defined(__aarch64__)
+		uint64_t t;
+		__asm__ volatile("mrs %0, cntvct_el0" : "=r"(t));
+		return t;
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	/** Audio thread, at the top of process(). Returns 0 for calls that
+	 *  are not timed, pass the result on to end().
+	 */
+	uint64_t begin() {
+		if (!enabled.load(std::memory_order_relaxed))
+			return 0;
+		if (--countdown > 0)
+			return 0;
+		countdown = SAMPLE_INTERVAL;
+		return ticks();
+	}
+
+	/** Audio thread, at the bottom of process().
+	 */
+	void end(uint64_t start, int channels) {
+		if (start == 0)
+			return;
+		uint64_t elapsed = ticks() - start;
+		if (resetRequested.load(std::memory_order_acquire)) {
+			clear();
+			resetRequested.store(false, std::memory_order_release);
+		}
+		add(calls, 1);
+		add(totalTicks, elapsed);
+		if (elapsed > worstTicks.load(std::memory_order_relaxed))
+			worstTicks.store(elapsed, std::memory_order_relaxed);
+		add(histogram[bucket(elapsed)], 1);
+		lastChannels.store(channels, std::memory_order_relaxed);
+	}
+
+	/** UI thread. Clears the counters before the next timed call.
+	 */
+	void reset() {
+		resetRequested.store(true, std::memory_order_release);
+	}
+
+	/** UI thread.
+	 */
+	Stats stats() const {
+		Stats s = {};
+		if (resetRequested.load(std::memory_order_acquire))
+			return s;
+		s.calls = calls.load(std::memory_order_relaxed);
+		s.channels = lastChannels.load(std::memory_order_relaxed);
+		if (s.calls == 0)
+			return s;
+		double nsPerTick = ticksToNs();
+		s.averageNs = totalTicks.load(std::memory_order_relaxed) * nsPerTick / s.calls;
+		s.worstNs = worstTicks.load(std::memory_order_relaxed) * nsPerTick;
+		// the bucket holding the call that 99 % of the calls do not exceed
+		uint64_t rank = s.calls - s.calls / 100;
+		uint64_t seen = 0;
+		for (int i = 0; i < BUCKETS; i++) {
+			seen += histogram[i].load(std::memory_order_relaxed);
+			if (seen >= rank) {
+				s.p99Ns = 0.5 * (bucketLow(i) + bucketLow(i + 1)) * nsPerTick;
+				break;
+			}
+		}
+		if (s.p99Ns > s.worstNs)
+			s.p99Ns = s.worstNs;
+		return s;
+	}
+
+	/** Counter ticks to nanoseconds, measured against steady_clock since
+	 *  the first call, which the plugin makes in init(). Good to a
+	 *  fraction of a percent once that is a second ago.
+	 */
+	static double ticksToNs() {
+		typedef std::chrono::steady_clock Clock;
+		static const uint64_t ticks0 = ticks();
+		static const Clock::time_point time0 = Clock::now();
+		uint64_t elapsedTicks = ticks() - ticks0;
+		double elapsedNs = std::chrono::duration<double, std::nano>(Clock::now() - time0).count();
+		if (elapsedTicks == 0 || elapsedNs < 1e6)
+			return 1.0;
+		return elapsedNs / elapsedTicks;
+	}
+
+private:
+	int countdown = 1;
+	std::atomic<bool> resetRequested;
+	std::atomic<uint64_t> calls;
+	std::atomic<uint64_t> totalTicks;
+	std::atomic<uint64_t> worstTicks;
+	std::atomic<int> lastChannels;
+	std::atomic<uint32_t> histogram[BUCKETS];
+
+	// single writer, so a plain load and store is enough
+	template <typename T, typename U>
+	static void add(std::atomic<T>& counter, U value) {
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	void clear() {
+		calls.store(0, std::memory_order_relaxed);
+		totalTicks.store(0, std::memory_order_relaxed);
+		worstTicks.store(0, std::memory_order_relaxed);
+		lastChannels.store(0, std::memory_order_relaxed);
+		for (int i = 0; i < BUCKETS; i++) {
+			histogram[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	// one bucket per tick up to 2 * SUB_BUCKETS, above that SUB_BUCKETS
+	// per octave
+	static int bucket(uint64_t t) {
+		if (t < 2 * SUB_BUCKETS)
+			return (int)t;
+		int octave = 63 - __builtin_clzll(t);
+		int sub = (int)(t >> (octave - 3)) & (SUB_BUCKETS - 1);
+		return (octave - 2) * SUB_BUCKETS + sub;
+	}
+
+	static double bucketLow(int i) {
+		if (i < 2 * SUB_BUCKETS)
+			return i;
+		int octave = i / SUB_BUCKETS + 2;
+		int sub = i % SUB_BUCKETS;
+		return std::ldexp((double)(SUB_BUCKETS + sub), octave - 3);
+	}
+};
@@ -0,0 +1,261 @@
+#pragma once
+#include <simd/functions.hpp>
+
+/** Rational tanh approximation from the continued fraction expansion,
+ *  truncated after the 7th term. The input is clamped to +-4.97, where the
+ *  fraction reaches 1, so the result is continuous, odd and bounded.
+ *  Absolute error against std::tanh is below 1e-4 over the whole real line.
+ *  T is float or simd::float_4.
+ */
+template <typename T>
+T tanhFast(T x)
+{
+    x = rack::simd::fmin(rack::simd::fmax(x, T(-4.97f)), T(4.97f));
+    T x2 = x * x;
+    T num = x * (135135.f + x2 * (17325.f + x2 * (378.f + x2)));
+    T den = 135135.f + x2 * (62370.f + x2 * (3150.f + x2 * 28.f));
+    return num / den;
+}
+
+/** SoftclipCore::saturate() keeps the knee from collapsing at full hardness.
+ */
+template <typename T>
+T limitHardness(T hardness)
+{
+    return rack::simd::ifelse(hardness == 1.f, T(0.999f), hardness);
+}
+
+inline double limitHardness(double hardness)
+{
+    return hardness == 1.0 ? 0.999 : hardness;
+}
+
+/** Linear up to +-hardness, tanh shaped knee above that.
+ *  Same curve as SoftclipCore::saturate(), with tanhFast() for the knee.
+ */
+template <typename T>
+T saturateFast(T in, T hardness)
+{
+    using namespace rack::simd;
+    hardness = limitHardness(hardness);
+    T c = fmax(-1.f * hardness, fmin(hardness, in));
+    T knee = 1.f - hardness;
+    return c + tanhFast((in - c) / knee) * knee;
+}
+
+/** SoftclipCore::saturate(), the curve the antiderivatives below
+ *  integrate, for the fallbacks of the exact saturation mode.
+ */
+inline float saturateExact(float in, float hardness)
+{
+    hardness = limitHardness(hardness);
+    float c = std::fmax(-hardness, std::fmin(hardness, in));
+    float k = 1.f - hardness;
+    return c + std::tanh((in - c) / k) * k;
+}
+
+inline rack::simd::float_4 saturateExact(rack::simd::float_4 in,
+                                         rack::simd::float_4 hardness)
+{
+    return rack::simd::float_4(saturateExact(in[0], hardness[0]),
+                               saturateExact(in[1], hardness[1]),
+                               saturateExact(in[2], hardness[2]),
+                               saturateExact(in[3], hardness[3]));
+}
+
+inline bool anyLane(bool mask)
+{
+    return mask;
+}
+
+inline bool anyLane(rack::simd::float_4 mask)
+{
+    return rack::simd::movemask(mask) != 0;
+}
+
+/** log(cosh(x)) that does not overflow for large |x|.
+ */
+template <typename T>
+T logCosh(T x)
+{
+    using namespace rack::simd;
+    T a = fabs(x);
+    return a + log(1.f + exp(-2.f * a)) - 0.69314718f;
+}
+
+inline double logCosh(double x)
+{
+    double a = std::fabs(x);
+    return a + std::log1p(std::exp(-2.0 * a)) - 0.69314718055994531;
+}
+
+/** Dilogarithm Li2(z) for z in [-1, 0], Bernoulli series in -log(1 - z).
+ */
+inline double dilog(double z)
+{
+    double u  = -std::log1p(-z);
+    double u2 = u * u;
+    return u * (1.0 + u * (-0.25 + u * (1.0 / 36.0 + u2 * (-1.0 / 3600.0
+           + u2 * (1.0 / 211680.0 + u2 * (-1.0 / 10886400.0
+           + u2 * (1.0 / 526901760.0)))))));
+}
+
+/** Integral of logCosh() from 0 to x.
+ */
+inline double logCoshIntegral(double x)
+{
+    double a = std::fabs(x);
+    double l = 0.5 * a * a - 0.69314718055994531 * a
+               + 0.5 * (dilog(-std::exp(-2.0 * a)) + 0.82246703342411322);
+    return x < 0.0 ? -l : l;
+}
+
+/** Antiderivatives of the SoftclipCore::saturate() curve
+ *  f(x) = c + k * tanh((x - c) / k), c = clamp(x, -hardness, hardness),
+ *  k = 1 - hardness:
+ *    F1(x) = c * x - c^2 / 2 + k^2 * logcosh((x - c) / k)
+ *    F2(x) = c * x^2 / 2 - c^2 * x / 2 + c^3 / 6 + k^3 * L((x - c) / k)
+ *  where L is the integral of logcosh. Both are continuous at the knee.
+ */
+template <typename T>
+T saturateAntiderivative(T in, T hardness)
+{
+    using namespace rack::simd;
+    hardness = limitHardness(hardness);
+    T c = fmax(-1.f * hardness, fmin(hardness, in));
+    T k = 1.f - hardness;
+    return c * in - 0.5f * c * c + k * k * logCosh((in - c) / k);
+}
+
+inline double saturateAntiderivative2(double in, double hardness)
+{
+    hardness = limitHardness(hardness);
+    double c = std::fmax(-hardness, std::fmin(hardness, in));
+    double k = 1.0 - hardness;
+    return c * in * (0.5 * in - 0.5 * c) + c * c * c / 6.0
+           + k * k * k * logCoshIntegral((in - c) / k);
+}
+
+/** First order antiderivative anti-aliasing of the saturation curve, half
+ *  a sample of delay. Falls back to the curve of the saturation mode,
+ *  saturateFast() or saturateExact(), at the midpoint when consecutive
+ *  inputs are too close for the difference quotient.
+ */
+template <typename T = float>
+class SaturatorADAA1
+{
+public:
+    void Reset()
+    {
+        x1_ = 0.f;
+        f1_ = 0.f;
+    }
+
+    T Process(T in, T hardness, bool fast)
+    {
+        using namespace rack::simd;
+        T    f1    = saturateAntiderivative(in, hardness);
+        T    dx    = in - x1_;
+        auto close = fabs(dx) < 1e-3f * fmax(1.f, fabs(in));
+        T    y     = (f1 - f1_) / dx;
+        // the exact curve runs per lane, only pay for it where needed
+        if(anyLane(close))
+        {
+            T mid = 0.5f * (in + x1_);
+            y     = ifelse(close,
+                       fast ? saturateFast(mid, hardness)
+                            : saturateExact(mid, hardness),
+                       y);
+        }
+        x1_ = in;
+        f1_ = f1;
+        return y;
+    }
+
+private:
+    T x1_;
+    T f1_;
+};
+
+/** Second order antiderivative anti-aliasing of SoftclipCore::saturate(),
+ *  one sample of delay. Runs in double precision since the second
+ *  antiderivative grows with the cube of the input and float loses the
+ *  differences. Like SaturatorADAA1 the last resort fallback follows the
+ *  saturation mode.
+ */
+class SaturatorADAA2
+{
+public:
+    void Reset()
+    {
+        x1_   = 0.0;
+        x2_   = 0.0;
+        d1_   = 0.0;
+        f2_1_ = 0.0;
+    }
+
+    double Process(double in, double hardness, bool fast)
+    {
+        double f2 = saturateAntiderivative2(in, hardness);
+        double d0 = Difference(in, x1_, f2, f2_1_, hardness);
+        double y;
+        double dx = in - x2_;
+        if(std::fabs(dx) > kTolerance * std::fmax(1.0, std::fabs(in)))
+        {
+            y = 2.0 * (d0 - d1_) / dx;
+        }
+        else
+        {
+            // x[n] ~ x[n-2], expand around their mean instead
+            double mean  = 0.5 * (in + x2_);
+            double delta = mean - x1_;
+            if(std::fabs(delta) > kTolerance * std::fmax(1.0, std::fabs(mean)))
+            {
+                y = 2.0 / delta
+                    * (saturateAntiderivative(mean, hardness)
+                       + (f2_1_ - saturateAntiderivative2(mean, hardness))
+                             / delta);
+            }
+            else
+            {
+                double x = 0.5 * (mean + x1_);
+                y = fast ? saturateFast<float>(x, hardness) : Saturate(x, hardness);
+            }
+        }
+        x2_   = x1_;
+        x1_   = in;
+        d1_   = d0;
+        f2_1_ = f2;
+        return y;
+    }
+
+private:
+    static constexpr double kTolerance = 1e-4;
+
+    double x1_;
+    double x2_;
+    double d1_;
+    double f2_1_;
+
+    static double Difference(double x0,
+                             double x1,
+                             double f2_0,
+                             double f2_1,
+                             double hardness)
+    {
+        double dx = x0 - x1;
+        if(std::fabs(dx) > kTolerance * std::fmax(1.0, std::fabs(x0)))
+        {
+            return (f2_0 - f2_1) / dx;
+        }
+        return saturateAntiderivative(0.5 * (x0 + x1), hardness);
+    }
+
+    static double Saturate(double in, double hardness)
+    {
+        hardness = limitHardness(hardness);
+        double c = std::fmax(-hardness, std::fmin(hardness, in));
+        double k = 1.0 - hardness;
+        return c + std::tanh((in - c) / k) * k;
+    }
+};
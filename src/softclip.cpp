@@ -1,7 +1,8 @@
 #include "plugin.hpp"
+#include "softclipcore.h"
 
 
-struct Softclip : Module {
+struct Softclip : TimedModule {
 	enum ParamId {
 		GAIN_PARAM,
 		GAINCVAMT_PARAM,
@@ -24,6 +25,8 @@ struct Softclip : Module {
 		LIGHTS_LEN
 	};
 
+	SoftclipCore softclip;
+
 	Softclip() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
 		configParam(GAIN_PARAM, -1.f, 1.f, 0.f, "gain");
@@ -37,17 +40,12 @@ struct Softclip : Module {
 		configOutput(MIXOUT_OUTPUT, "mixoutput");
         outputs[MIXOUT_OUTPUT].setChannels(1);
 	}
-	
-	float saturate(float inValue, float hardness) {
-        hardness = hardness == 1.f ? 0.999 : hardness;
-        float c = std::max(-1 * hardness, std::min(hardness, inValue));
-        return c + tanh((inValue - c) / (1 - hardness)) * (1 - hardness);
-    }
 
 	void process(const ProcessArgs& args) override {
+        uint64_t start = processTimer.begin();
+        int channels = 0;
         if (inputs[INPUT_INPUT].isConnected() && (outputs[OUTPUT_OUTPUT].isConnected() || outputs[MIXOUT_OUTPUT].isConnected())) {
-            float mix = 0.f;
-            int channels = inputs[INPUT_INPUT].getChannels();
+            channels = inputs[INPUT_INPUT].getChannels();
             outputs[OUTPUT_OUTPUT].setChannels(channels);
             float gain = powf(8, params[GAIN_PARAM].getValue());
             float hardness = params[HARDN_PARAM].getValue();
@@ -57,13 +55,33 @@ struct Softclip : Module {
             if (inputs[HARDNCVIN_INPUT].isConnected()) {
                 hardness *= params[HARDNCVAMT_PARAM].getValue() * (inputs[HARDNCVIN_INPUT].getVoltage() / 10);
             }
-            for (int i=0; i < channels; i++) {
-                float in = inputs[INPUT_INPUT].getPolyVoltage(i);
-                mix += gain * in / channels;
-                outputs[OUTPUT_OUTPUT].setVoltage(10.f * saturate(gain * in, hardness), i);
-            }
-            outputs[MIXOUT_OUTPUT].setVoltage(10.f * saturate(mix, hardness));
+            float mix = softclip.process(inputs[INPUT_INPUT].getVoltages(), outputs[OUTPUT_OUTPUT].getVoltages(), channels, gain, hardness);
+            outputs[MIXOUT_OUTPUT].setVoltage(mix);
         }
+        processTimer.end(start, channels);
+	}
+
+	json_t* dataToJson() override {
+		json_t* rootJ = json_object();
+		json_object_set_new(rootJ, "saturationMode", json_integer(softclip.saturationMode));
+		json_object_set_new(rootJ, "oversampling", json_integer(softclip.oversampling));
+		json_object_set_new(rootJ, "adaa", json_integer(softclip.adaa));
+		return rootJ;
+	}
+
+	void dataFromJson(json_t* rootJ) override {
+		json_t* saturationModeJ = json_object_get(rootJ, "saturationMode");
+		if (saturationModeJ) {
+			softclip.setSaturationMode(clamp((int)json_integer_value(saturationModeJ), 0, SoftclipCore::SATURATION_MODES_LEN - 1));
+		}
+		json_t* oversamplingJ = json_object_get(rootJ, "oversampling");
+		if (oversamplingJ) {
+			softclip.setOversampling(clamp((int)json_integer_value(oversamplingJ), 0, Oversampler<float>::kMaxStages));
+		}
+		json_t* adaaJ = json_object_get(rootJ, "adaa");
+		if (adaaJ) {
+			softclip.setAdaa(clamp((int)json_integer_value(adaaJ), 0, 2));
+		}
 	}
 };
 
@@ -90,6 +108,26 @@ struct SoftclipWidget : ModuleWidget {
 		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(30.739, 107.067)), module, Softclip::OUTPUT_OUTPUT));
 		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(30.739, 120.067)), module, Softclip::MIXOUT_OUTPUT));
 	}
+
+	void appendContextMenu(Menu* menu) override {
+		Softclip* module = getModule<Softclip>();
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createIndexSubmenuItem("Saturation", {"Exact", "Fast"},
+			[=]() {return module->softclip.saturationMode;},
+			[=](int i) {module->softclip.setSaturationMode(i);}
+		));
+		menu->addChild(createIndexSubmenuItem("Oversampling", {"Off", "2x", "4x", "8x"},
+			[=]() {return module->softclip.oversampling;},
+			[=](int i) {module->softclip.setOversampling(i);},
+			module->softclip.adaa > 0
+		));
+		menu->addChild(createIndexSubmenuItem("Antiderivative anti-aliasing", {"Off", "1st order", "2nd order"},
+			[=]() {return module->softclip.adaa;},
+			[=](int i) {module->softclip.setAdaa(i);}
+		));
+		appendProcessTimerMenu(menu, module);
+	}
 };
 
 
@@ -0,0 +1,143 @@
+#pragma once
+#include <atomic>
+#include "saturate.h"
+#include "oversampler.h"
+#include "cpudispatch.h"
+
+/** Softclip's signal path, independent of the Rack engine so it can also
+ *  run in the headless tools.
+ */
+struct SoftclipCore {
+	typedef rack::simd::float_4 float_4;
+	static const int MAX_CHANNELS = 16;
+
+	enum SaturationMode {
+		EXACT_SATURATION,
+		FAST_SATURATION,
+		SATURATION_MODES_LEN
+	};
+
+	// set through the setters below, which restart the filter and
+	// anti-aliasing history
+	int saturationMode = EXACT_SATURATION;
+	// oversampling factor is 2^oversampling
+	int oversampling = 0;
+	std::atomic<bool> resetRequested;
+	Oversampler<float_4> oversamplers[MAX_CHANNELS / 4];
+	Oversampler<float> mixOversampler;
+	// antiderivative anti-aliasing order, replaces oversampling when enabled
+	int adaa = 0;
+	SaturatorADAA1<float_4> adaa1[MAX_CHANNELS / 4];
+	SaturatorADAA1<float> mixAdaa1;
+	SaturatorADAA2 adaa2[MAX_CHANNELS];
+	SaturatorADAA2 mixAdaa2;
+
+	SoftclipCore() : resetRequested(false) {
+		for (int i = 0; i < MAX_CHANNELS / 4; i++) {
+			oversamplers[i].Init();
+		}
+		mixOversampler.Init();
+		reset();
+	}
+
+	/** The mode setters run on the UI thread, the history they invalidate
+	 *  is cleared by the next process() call on the audio thread.
+	 */
+	void setSaturationMode(int mode) {
+		saturationMode = mode;
+		resetRequested = true;
+	}
+
+	void setOversampling(int stages) {
+		oversampling = stages;
+		resetRequested = true;
+	}
+
+	void setAdaa(int order) {
+		adaa = order;
+		resetRequested = true;
+	}
+
+	/** Clears the oversampling filters and the anti-aliasing history, so
+	 *  the first sample in a new mode does not difference against a
+	 *  sample shaped by another curve.
+	 */
+	void reset() {
+		for (int i = 0; i < MAX_CHANNELS / 4; i++) {
+			oversamplers[i].Reset();
+			adaa1[i].Reset();
+		}
+		mixOversampler.Reset();
+		for (int i = 0; i < MAX_CHANNELS; i++) {
+			adaa2[i].Reset();
+		}
+		mixAdaa1.Reset();
+		mixAdaa2.Reset();
+	}
+
+	float saturate(float inValue, float hardness) {
+        hardness = hardness == 1.f ? 0.999 : hardness;
+        float c = std::max(-1 * hardness, std::min(hardness, inValue));
+        return c + tanh((inValue - c) / (1 - hardness)) * (1 - hardness);
+    }
+
+	float_4 saturate(float_4 inValue, float hardness) {
+		return float_4(saturate(inValue[0], hardness), saturate(inValue[1], hardness), saturate(inValue[2], hardness), saturate(inValue[3], hardness));
+	}
+
+	float antialias2(float in, float hardness, bool fast, SaturatorADAA2* adaa2) {
+		return adaa2[0].Process(in, hardness, fast);
+	}
+
+	float_4 antialias2(float_4 in, float hardness, bool fast, SaturatorADAA2* adaa2) {
+		return float_4(adaa2[0].Process(in[0], hardness, fast), adaa2[1].Process(in[1], hardness, fast), adaa2[2].Process(in[2], hardness, fast), adaa2[3].Process(in[3], hardness, fast));
+	}
+
+	template <typename T>
+	T shape(T in, float hardness, Oversampler<T>& oversampler, SaturatorADAA1<T>& adaa1, SaturatorADAA2* adaa2) {
+		bool fast = saturationMode == FAST_SATURATION;
+		if (adaa == 1) {
+			return adaa1.Process(in, hardness, fast);
+		}
+		if (adaa == 2) {
+			return antialias2(in, hardness, fast, adaa2);
+		}
+		auto shaper = [&](T x) {
+			return fast ? saturateFast<T>(x, hardness) : saturate(x, hardness);
+		};
+		return oversampling > 0 ? oversampler.Process(in, oversampling, shaper) : shaper(in);
+	}
+
+	/** Saturates channels voltages of in into out, returns the saturated mix.
+	 *  in and out are read and written in groups of four.
+	 */
+	float process(const float* in, float* out, int channels, float gain, float hardness) {
+#if NB_CPU_DISPATCH
+		// only the antiderivative paths measured faster in the AVX2 build,
+		// the plain and oversampled ones ran the same or slower
+		if (CpuDispatch::level() == CpuDispatch::AVX2 && adaa > 0)
+			return renderAvx2(in, out, channels, gain, hardness);
+#endif
+		return render(in, out, channels, gain, hardness);
+	}
+
+#if NB_CPU_DISPATCH
+	NB_TARGET_AVX2 float renderAvx2(const float* in, float* out, int channels, float gain, float hardness) {
+		return render(in, out, channels, gain, hardness);
+	}
+#endif
+
+	float render(const float* in, float* out, int channels, float gain, float hardness) {
+		if (resetRequested.load(std::memory_order_relaxed) && resetRequested.exchange(false)) {
+			reset();
+		}
+		float_4 mix4 = 0.f;
+		for (int c = 0; c < channels; c += 4) {
+			float_4 x = gain * float_4::load(in + c);
+			mix4 += ifelse(float_4(c, c + 1, c + 2, c + 3) < channels, x, 0.f);
+			(10.f * shape(x, hardness, oversamplers[c / 4], adaa1[c / 4], &adaa2[c])).store(out + c);
+		}
+		float mix = (mix4[0] + mix4[1] + mix4[2] + mix4[3]) / channels;
+		return 10.f * shape(mix, hardness, mixOversampler, mixAdaa1, &mixAdaa2);
+	}
+};
@@ -1,9 +1,26 @@
 #pragma once
-class VariableShapeOscillator
+#include <cstddef>
+#include <simd/functions.hpp>
+
+/** What an oscillator renders, fixed at compile time. The variable shape
+ *  morphs with SetWaveshape(), from the variable slope triangle at 0 over
+ *  saw at 0.5 to square at 1. The fixed shapes are the two ends, rendered
+ *  with only the BLEP and naive terms they need; SetWaveshape() does
+ *  nothing for them.
+ */
+enum OscillatorShape
+{
+    OSCILLATOR_SHAPE_VARIABLE,
+    OSCILLATOR_SHAPE_TRISAW,
+    OSCILLATOR_SHAPE_SQUARE,
+};
+
+template <OscillatorShape shape>
+class BasicVariableShapeOscillator
 {
 public:
-    VariableShapeOscillator() {}
-    ~VariableShapeOscillator() {}
+    BasicVariableShapeOscillator() {}
+    ~BasicVariableShapeOscillator() {}
     
     void Init(float sample_rate)
     {
@@ -21,67 +38,41 @@ public:
     
     float Process()
     {
-        float next_sample = next_sample_;
-        
-        float this_sample = next_sample;
-        next_sample       = 0.0f;
-        
-        const float square_amount   = fmax(waveshape_ - 0.5f, 0.0f) * 2.0f;
-        const float triangle_amount = fmax(1.0f - waveshape_ * 2.0f, 0.0f);
-        const float slope_up        = 1.0f / (pw_);
-        const float slope_down      = 1.0f / (1.0f - pw_);
-        
-        slave_phase_ += slave_frequency_;
-        if(!high_)
+        return ProcessSample(slave_frequency_, pw_);
+    }
+
+    /** Renders size samples while ramping frequency (in cycles per sample)
+     *  and pulse width linearly from the current values to the ones given,
+     *  which are then kept for later calls.
+     */
+    void ProcessBlock(float frequency, float pw, float* out, size_t size)
+    {
+        const float start_frequency = slave_frequency_;
+        const float start_pw        = pw_;
+        SetPhaseIncrement(frequency);
+        SetPW(pw);
+
+        // Both ends respect the pulse width limits and the limits are linear
+        // in frequency, so every point of the ramp does too.
+        const float frequency_increment
+            = (slave_frequency_ - start_frequency) / (float)size;
+        const float pw_increment = (pw_ - start_pw) / (float)size;
+        for(size_t i = 0; i < size; i++)
         {
-            if(slave_phase_ > pw_)
-            {
-                float t = (slave_phase_ - pw_)
-                / (previous_pw_ - pw_ + slave_frequency_);
-                float triangle_step = (slope_up + slope_down) * slave_frequency_;
-                triangle_step *= triangle_amount;
-                
-                this_sample += square_amount * ThisBlepSample(t);
-                next_sample += square_amount * NextBlepSample(t);
-                this_sample -= triangle_step * ThisIntegratedBlepSample(t);
-                next_sample -= triangle_step * NextIntegratedBlepSample(t);
-                high_ = true;
-            }
+            out[i] = ProcessSample(start_frequency + frequency_increment * (float)(i + 1),
+                                   start_pw + pw_increment * (float)(i + 1));
         }
-        
-        if(high_)
-        {
-            if(slave_phase_ > 1.0f)
-            {
-                slave_phase_ -= 1.0f;
-                float t             = slave_phase_ / slave_frequency_;
-                float triangle_step = (slope_up + slope_down) * slave_frequency_;
-                triangle_step *= triangle_amount;
-                
-                this_sample -= (1.0f - triangle_amount) * ThisBlepSample(t);
-                next_sample -= (1.0f - triangle_amount) * NextBlepSample(t);
-                this_sample += triangle_step * ThisIntegratedBlepSample(t);
-                next_sample += triangle_step * NextIntegratedBlepSample(t);
-                high_ = false;
-            }
-        }
-        
-        next_sample += ComputeNaiveSample(slave_phase_,
-                                          pw_,
-                                          slope_up,
-                                          slope_down,
-                                          triangle_amount,
-                                          square_amount);
-        previous_pw_ = pw_;
-        
-        
-        next_sample_ = next_sample;
-        return (2.0f * this_sample - 1.0f);
     }
-    
+
     void SetFreq(float frequency)
     {
-        frequency         = frequency / sample_rate_;
+        SetPhaseIncrement(frequency / sample_rate_);
+    }
+
+    /** Frequency in cycles per sample, e.g. from PitchConverter.
+     */
+    void SetPhaseIncrement(float frequency)
+    {
         frequency         = frequency >= .25f ? .25f : frequency;
         slave_frequency_ = frequency;
     }
@@ -117,6 +108,101 @@ private:
     float slave_frequency_;
     float pw_;
     float waveshape_;
+
+    float SquareAmount()
+    {
+        return shape == OSCILLATOR_SHAPE_SQUARE   ? 1.0f
+               : shape == OSCILLATOR_SHAPE_TRISAW ? 0.0f
+                                                  : fmax(waveshape_ - 0.5f, 0.0f) * 2.0f;
+    }
+
+    float TriangleAmount()
+    {
+        return shape == OSCILLATOR_SHAPE_TRISAW   ? 1.0f
+               : shape == OSCILLATOR_SHAPE_SQUARE ? 0.0f
+                                                  : fmax(1.0f - waveshape_ * 2.0f, 0.0f);
+    }
+
+    float ProcessSample(float frequency, float pw)
+    {
+        float next_sample = next_sample_;
+        
+        float this_sample = next_sample;
+        next_sample       = 0.0f;
+        
+        const float square_amount   = SquareAmount();
+        const float triangle_amount = TriangleAmount();
+        const float slope_up        = 1.0f / (pw);
+        const float slope_down      = 1.0f / (1.0f - pw);
+        
+        slave_phase_ += frequency;
+        if(!high_)
+        {
+            if(slave_phase_ > pw)
+            {
+                float t = (slave_phase_ - pw)
+                / (previous_pw_ - pw + frequency);
+                if(shape == OSCILLATOR_SHAPE_SQUARE)
+                {
+                    this_sample += ThisBlepSample(t);
+                    next_sample += NextBlepSample(t);
+                }
+                else
+                {
+                    float triangle_step = (slope_up + slope_down) * frequency;
+                    if(shape == OSCILLATOR_SHAPE_VARIABLE)
+                    {
+                        triangle_step *= triangle_amount;
+                        this_sample += square_amount * ThisBlepSample(t);
+                        next_sample += square_amount * NextBlepSample(t);
+                    }
+                    this_sample -= triangle_step * ThisIntegratedBlepSample(t);
+                    next_sample -= triangle_step * NextIntegratedBlepSample(t);
+                }
+                high_ = true;
+            }
+        }
+        
+        if(high_)
+        {
+            if(slave_phase_ > 1.0f)
+            {
+                slave_phase_ -= 1.0f;
+                float t             = slave_phase_ / frequency;
+                if(shape == OSCILLATOR_SHAPE_SQUARE)
+                {
+                    this_sample -= ThisBlepSample(t);
+                    next_sample -= NextBlepSample(t);
+                }
+                else
+                {
+                    float triangle_step = (slope_up + slope_down) * frequency;
+                    if(shape == OSCILLATOR_SHAPE_VARIABLE)
+                    {
+                        triangle_step *= triangle_amount;
+                        this_sample -= (1.0f - triangle_amount) * ThisBlepSample(t);
+                        next_sample -= (1.0f - triangle_amount) * NextBlepSample(t);
+                    }
+                    this_sample += triangle_step * ThisIntegratedBlepSample(t);
+                    next_sample += triangle_step * NextIntegratedBlepSample(t);
+                }
+                high_ = false;
+            }
+        }
+        
+        next_sample += ComputeNaiveSample(slave_phase_,
+                                          pw,
+                                          slope_up,
+                                          slope_down,
+                                          triangle_amount,
+                                          square_amount);
+        previous_pw_ = pw;
+        
+        
+        next_sample_ = next_sample;
+        return (2.0f * this_sample - 1.0f);
+    }
+
     float ComputeNaiveSample(float phase,
                              float pw,
                              float slope_up,
@@ -124,10 +210,18 @@ private:
                              float triangle_amount,
                              float square_amount)
     {
-        float saw    = phase;
         float square = phase < pw ? 0.0f : 1.0f;
         float triangle
         = phase < pw ? phase * slope_up : 1.0f - (phase - pw) * slope_down;
+        if(shape == OSCILLATOR_SHAPE_SQUARE)
+        {
+            return square;
+        }
+        if(shape == OSCILLATOR_SHAPE_TRISAW)
+        {
+            return triangle;
+        }
+        float saw = phase;
         saw += (square - saw) * square_amount;
         saw += (triangle - saw) * triangle_amount;
         return saw;
@@ -185,3 +279,279 @@ private:
         return NextIntegratedBlepSample(1.0f - t);
     }
 };
+
+typedef BasicVariableShapeOscillator<OSCILLATOR_SHAPE_VARIABLE> VariableShapeOscillator;
+typedef BasicVariableShapeOscillator<OSCILLATOR_SHAPE_TRISAW> TriSawOscillator;
+typedef BasicVariableShapeOscillator<OSCILLATOR_SHAPE_SQUARE> SquareOscillator;
+
+/** Four VariableShapeOscillators in structure-of-arrays form, one voice per
+ *  float_4 lane. The edge transitions of the scalar version are evaluated
+ *  for all lanes and selected with masks instead of branching on high_.
+ */
+template <OscillatorShape shape>
+class BasicVariableShapeOscillatorBank
+{
+public:
+    typedef rack::simd::float_4 float_4;
+
+    BasicVariableShapeOscillatorBank() {}
+    ~BasicVariableShapeOscillatorBank() {}
+
+    void Init(float sample_rate)
+    {
+        sample_rate_ = sample_rate;
+
+        slave_phase_ = 0.0f;
+        next_sample_ = 0.0f;
+        previous_pw_ = 0.5f;
+        high_        = float_4::zero();
+
+        SetFreq(440.f);
+        SetWaveshape(0.f);
+        SetPW(0.f);
+    }
+
+    float_4 Process()
+    {
+        return ProcessSample(slave_frequency_, pw_);
+    }
+
+    /** Same as VariableShapeOscillator::ProcessBlock(), per lane.
+     */
+    void ProcessBlock(float_4 frequency, float_4 pw, float_4* out, size_t size)
+    {
+        const float_4 start_frequency = slave_frequency_;
+        const float_4 start_pw        = pw_;
+        SetPhaseIncrement(frequency);
+        SetPW(pw);
+
+        const float_4 frequency_increment
+            = (slave_frequency_ - start_frequency) / (float)size;
+        const float_4 pw_increment = (pw_ - start_pw) / (float)size;
+        for(size_t i = 0; i < size; i++)
+        {
+            out[i] = ProcessSample(start_frequency + frequency_increment * (float)(i + 1),
+                                   start_pw + pw_increment * (float)(i + 1));
+        }
+    }
+
+    /** Moves the phase on by one sample without rendering, for voices that
+     *  are muted anyway. Call Resync() before the next Process().
+     */
+    void Advance()
+    {
+        slave_phase_ += slave_frequency_;
+        slave_phase_ -= rack::simd::floor(slave_phase_);
+    }
+
+    /** Picks up rendering at the current phase after Advance(), as if the
+     *  oscillator had been running. Only the band limiting of edges passed
+     *  while muted is lost.
+     */
+    void Resync()
+    {
+        high_        = slave_phase_ > pw_;
+        next_sample_ = ComputeNaiveSample(slave_phase_,
+                                          pw_,
+                                          1.0f / pw_,
+                                          1.0f / (1.0f - pw_),
+                                          TriangleAmount(),
+                                          SquareAmount());
+        previous_pw_ = pw_;
+    }
+
+    /** Jumps to a new phase, 0..1. Call Resync() before the next Process().
+     */
+    void SetPhase(float_4 phase)
+    {
+        slave_phase_ = phase - rack::simd::floor(phase);
+    }
+
+    void SetFreq(float_4 frequency)
+    {
+        SetPhaseIncrement(frequency / sample_rate_);
+    }
+
+    void SetPhaseIncrement(float_4 frequency)
+    {
+        slave_frequency_ = rack::simd::fmin(frequency, .25f);
+    }
+
+    void SetPW(float_4 pw)
+    {
+        using namespace rack::simd;
+        pw_ = ifelse(slave_frequency_ >= .25f,
+                     .5f,
+                     fmin(fmax(pw, slave_frequency_ * .5f),
+                          1.0f - .5f * slave_frequency_));
+    }
+
+    void SetWaveshape(float_4 waveshape)
+    {
+        waveshape_ = waveshape;
+    }
+
+private:
+    float sample_rate_;
+
+    // Oscillator state.
+    float_4 slave_phase_;
+    float_4 next_sample_;
+    float_4 previous_pw_;
+    float_4 high_;
+
+    // For interpolation of parameters.
+    float_4 slave_frequency_;
+    float_4 pw_;
+    float_4 waveshape_;
+
+    float_4 SquareAmount()
+    {
+        return shape == OSCILLATOR_SHAPE_SQUARE   ? float_4(1.0f)
+               : shape == OSCILLATOR_SHAPE_TRISAW ? float_4::zero()
+                                                  : rack::simd::fmax(waveshape_ - 0.5f, 0.0f) * 2.0f;
+    }
+
+    float_4 TriangleAmount()
+    {
+        return shape == OSCILLATOR_SHAPE_TRISAW   ? float_4(1.0f)
+               : shape == OSCILLATOR_SHAPE_SQUARE ? float_4::zero()
+                                                  : rack::simd::fmax(1.0f - waveshape_ * 2.0f, 0.0f);
+    }
+
+    float_4 ProcessSample(float_4 frequency, float_4 pw)
+    {
+        using namespace rack::simd;
+
+        float_4 this_sample = next_sample_;
+        float_4 next_sample = 0.0f;
+
+        const float_4 square_amount   = SquareAmount();
+        const float_4 triangle_amount = TriangleAmount();
+        const float_4 slope_up        = 1.0f / (pw);
+        const float_4 slope_down      = 1.0f / (1.0f - pw);
+        float_4       triangle_step   = (slope_up + slope_down) * frequency;
+        if(shape == OSCILLATOR_SHAPE_VARIABLE)
+        {
+            triangle_step *= triangle_amount;
+        }
+
+        slave_phase_ += frequency;
+
+        const float_4 rising = ~high_ & (slave_phase_ > pw);
+        if(movemask(rising))
+        {
+            float_4 t = (slave_phase_ - pw)
+            / (previous_pw_ - pw + frequency);
+
+            if(shape == OSCILLATOR_SHAPE_SQUARE)
+            {
+                this_sample += rising & ThisBlepSample(t);
+                next_sample += rising & NextBlepSample(t);
+            }
+            else if(shape == OSCILLATOR_SHAPE_TRISAW)
+            {
+                this_sample -= rising & (triangle_step * ThisIntegratedBlepSample(t));
+                next_sample -= rising & (triangle_step * NextIntegratedBlepSample(t));
+            }
+            else
+            {
+                this_sample += rising & (square_amount * ThisBlepSample(t)
+                               - triangle_step * ThisIntegratedBlepSample(t));
+                next_sample += rising & (square_amount * NextBlepSample(t)
+                               - triangle_step * NextIntegratedBlepSample(t));
+            }
+            high_ = high_ | rising;
+        }
+
+        const float_4 falling = high_ & (slave_phase_ > 1.0f);
+        if(movemask(falling))
+        {
+            slave_phase_ -= falling & 1.0f;
+            float_4 t = slave_phase_ / frequency;
+
+            if(shape == OSCILLATOR_SHAPE_SQUARE)
+            {
+                this_sample -= falling & ThisBlepSample(t);
+                next_sample -= falling & NextBlepSample(t);
+            }
+            else if(shape == OSCILLATOR_SHAPE_TRISAW)
+            {
+                this_sample += falling & (triangle_step * ThisIntegratedBlepSample(t));
+                next_sample += falling & (triangle_step * NextIntegratedBlepSample(t));
+            }
+            else
+            {
+                this_sample += falling & (triangle_step * ThisIntegratedBlepSample(t)
+                               - (1.0f - triangle_amount) * ThisBlepSample(t));
+                next_sample += falling & (triangle_step * NextIntegratedBlepSample(t)
+                               - (1.0f - triangle_amount) * NextBlepSample(t));
+            }
+            high_ = high_ & ~falling;
+        }
+
+        next_sample += ComputeNaiveSample(slave_phase_,
+                                          pw,
+                                          slope_up,
+                                          slope_down,
+                                          triangle_amount,
+                                          square_amount);
+        previous_pw_ = pw;
+
+        next_sample_ = next_sample;
+        return (2.0f * this_sample - 1.0f);
+    }
+
+    float_4 ComputeNaiveSample(float_4 phase,
+                               float_4 pw,
+                               float_4 slope_up,
+                               float_4 slope_down,
+                               float_4 triangle_amount,
+                               float_4 square_amount)
+    {
+        const float_4 low = phase < pw;
+        float_4 square    = rack::simd::ifelse(low, 0.0f, 1.0f);
+        float_4 triangle  = rack::simd::ifelse(
+            low, phase * slope_up, 1.0f - (phase - pw) * slope_down);
+        if(shape == OSCILLATOR_SHAPE_SQUARE)
+        {
+            return square;
+        }
+        if(shape == OSCILLATOR_SHAPE_TRISAW)
+        {
+            return triangle;
+        }
+        float_4 saw = phase;
+        saw += (square - saw) * square_amount;
+        saw += (triangle - saw) * triangle_amount;
+        return saw;
+    }
+
+    float_4 ThisBlepSample(float_4 t)
+    {
+        return 0.5f * t * t;
+    }
+
+    float_4 NextBlepSample(float_4 t)
+    {
+        t = 1.0f - t;
+        return -0.5f * t * t;
+    }
+
+    float_4 NextIntegratedBlepSample(float_4 t)
+    {
+        const float_4 t1 = 0.5f * t;
+        const float_4 t2 = t1 * t1;
+        const float_4 t4 = t2 * t2;
+        return 0.1875f - t1 + 1.5f * t2 - t4;
+    }
+
+    float_4 ThisIntegratedBlepSample(float_4 t)
+    {
+        return NextIntegratedBlepSample(1.0f - t);
+    }
+};
+
+typedef BasicVariableShapeOscillatorBank<OSCILLATOR_SHAPE_VARIABLE> VariableShapeOscillatorBank;
+typedef BasicVariableShapeOscillatorBank<OSCILLATOR_SHAPE_TRISAW> TriSawOscillatorBank;
+typedef BasicVariableShapeOscillatorBank<OSCILLATOR_SHAPE_SQUARE> SquareOscillatorBank;
@@ -0,0 +1,416 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include "variableshapeosc.h"
+#include "wavetableosc.h"
+#include "pitch.h"
+#include "voicebus.h"
+#include "objectswap.h"
+#include "cpudispatch.h"
+
+/** VarTriSaw's oscillator voices, independent of the Rack engine so they
+ *  can also run in the headless tools.
+ */
+struct VarTriSawCore {
+	typedef rack::simd::float_4 float_4;
+	static const int MAX_CHANNELS = 16;
+	// voices from a Polyfotz bus, folded onto the MAX_CHANNELS outputs
+	static const int MAX_VOICES = VoiceBusMessage::MAX_VOICES;
+	// oscillators per voice in unison mode
+	static const int MAX_UNISON = 8;
+	static const int MAX_BANKS = MAX_UNISON * MAX_VOICES / 4;
+
+	/** A polyphonic input as the module sees it. A monophonic input applies
+	 *  to every channel, an unpatched one has 0 channels.
+	 */
+	struct PolyInput {
+		const float* voltages;
+		int channels;
+
+		float_4 getPolyVoltage(int c) const {
+			return channels == 1 ? float_4(voltages[0]) : float_4::load(voltages + c);
+		}
+	};
+
+	/** The per voice values render() reads, from the module's cables.
+	 */
+	struct CableVoices {
+		const PolyInput& voct;
+		const PolyInput& aft;
+		const PolyInput& gainIn;
+		PitchConverter& pitch;
+
+		int channels() const {
+			return std::max(aft.channels, voct.channels);
+		}
+		bool gainConnected() const {
+			return gainIn.channels > 0;
+		}
+		float_4 phaseIncrement(int c) const {
+			return pitch.PhaseIncrement(voct.getPolyVoltage(c));
+		}
+		float_4 pwm(int c) const {
+			return aft.getPolyVoltage(c) / 10.f;
+		}
+		float_4 gain(int c) const {
+			return gainIn.getPolyVoltage(c);
+		}
+	};
+
+	/** The same from a Polyfotz bus message.
+	 */
+	struct BusVoices {
+		const VoiceBusMessage& bus;
+
+		int channels() const {
+			return std::max(0, std::min(bus.voices, (int)MAX_VOICES));
+		}
+		bool gainConnected() const {
+			return true;
+		}
+		float_4 phaseIncrement(int c) const {
+			return bus.phaseIncrement[c / 4];
+		}
+		float_4 pwm(int c) const {
+			return bus.pwm[c / 4];
+		}
+		float_4 gain(int c) const {
+			return bus.gain[c / 4];
+		}
+	};
+
+	// gain below this counts as silent for voice culling, -80 dB of 10 V
+	static constexpr float CULL_THRESHOLD = 1e-3f;
+
+	/** The wavetable engine costs more than the BLEP banks at every voice
+	 *  count. At 0 V, `bench --only VarTriSaw --cpu baseline` measures ~63
+	 *  against ~109 ns per sample at 1 to 4 voices and ~197 against ~361 at
+	 *  16, so there is no crossover up to MAX_CHANNELS. It is there for its
+	 *  lower aliasing, not for speed: `aliasing --only VarTriSaw` measures
+	 *  its audible aliases at least 8 dB below polyBLEP's at every pitch and
+	 *  pulse width it sweeps.
+	 */
+	enum Engine {
+		BLEP_ENGINE,
+		WAVETABLE_ENGINE,
+		ENGINES_LEN
+	};
+
+	/** The unison oscillators packed voice after voice into the bank
+	 *  lanes. Every voice's oscillators are spread evenly over +-detune
+	 *  and +-pw spread, and start at staggered phases so they do not comb
+	 *  filter at first. The sum is scaled by 1 / sqrt(unison) to keep the
+	 *  loudness, so peaks can exceed a single oscillator's where the phases
+	 *  line up. Built by setUnison() off the audio thread.
+	 */
+	struct UnisonLayout {
+		int unison;
+		float gain;
+		int laneVoice[MAX_BANKS * 4];
+		float_4 ratio[MAX_BANKS];
+		float_4 pwOffset[MAX_BANKS];
+		float_4 phase[MAX_BANKS];
+
+		UnisonLayout(int unison = 1, float detune = 0.f, float pwSpread = 0.f) {
+			this->unison = unison;
+			gain = 1.f / std::sqrt((float)unison);
+			for (int lane = 0; lane < MAX_BANKS * 4; lane++) {
+				int voice = lane / unison;
+				int osc = lane % unison;
+				// -1..1 across the voice's oscillators
+				float position = unison > 1 ? 2.f * osc / (unison - 1) - 1.f : 0.f;
+				laneVoice[lane] = voice < MAX_VOICES ? voice : 0;
+				ratio[lane / 4][lane % 4] = std::pow(2.f, position * detune / 12.f);
+				pwOffset[lane / 4][lane % 4] = position * pwSpread;
+				// golden ratio steps, the first oscillator of a voice at 0
+				phase[lane / 4][lane % 4] = unison > 1 ? osc * .618034f : 0.f;
+			}
+		}
+	};
+
+	// written by setEngine() after the tables are ready, read by render
+	std::atomic<int> engine;
+	// one bank per group of four voices, or of four unison oscillators
+	SquareOscillatorBank SQRosc[MAX_BANKS];
+	TriSawOscillatorBank SAWosc[MAX_BANKS];
+	// only initialized once the wavetable engine is first selected
+	WavetableOscillatorBank SQRtable[MAX_BANKS], SAWtable[MAX_BANKS];
+	// UI thread only, the audio thread learns about the tables from engine
+	bool tablesReady = false;
+	// per voice, repeating every MAX_CHANNELS voices
+	float_4 aft_amt[MAX_VOICES / 4];
+	PitchConverter pitch;
+
+	// voice culling: samples each voice has been silent, capped at the hold
+	float_4 silentSamples[MAX_VOICES / 4];
+	// per bank, also set when the bank has to resync for other reasons
+	bool culled[MAX_BANKS];
+
+	ObjectSwap<UnisonLayout> layouts;
+	// counts the layouts the audio thread took, and per engine and bank the
+	// one whose phases the bank was last restarted at
+	int layoutGeneration = 0;
+	int bankGeneration[ENGINES_LEN][MAX_BANKS] = {};
+	// per voice values the unison lanes gather from
+	float voiceFreq[MAX_VOICES] = {};
+	float voiceSawPw[MAX_VOICES] = {};
+	float voiceSqrPw[MAX_VOICES] = {};
+	float voiceGain[MAX_VOICES] = {};
+	float voiceHeld[MAX_VOICES] = {};
+	// bus voices before folding
+	float foldSaw[MAX_VOICES] = {};
+	float foldSqr[MAX_VOICES] = {};
+	float cullHoldTime = .05f;
+	float cullHoldSamples = 0.f;
+	float sampleRate = 44100.f;
+
+	VarTriSawCore() : engine(BLEP_ENGINE) {}
+
+	void init(float sampleRate) {
+		float pi_halves = std::atan(1) * 2;
+		for (int i = 0; i < MAX_BANKS; i++) {
+			SAWosc[i].Init(sampleRate);
+			SQRosc[i].Init(sampleRate);
+			culled[i] = false;
+		}
+		pitch.Init(sampleRate);
+		for (int i = 0; i < MAX_VOICES / 4; i++) {
+			silentSamples[i] = 0.f;
+		}
+		setSampleRate(sampleRate);
+		for (int i = 0; i < MAX_VOICES; i++) {
+			aft_amt[i / 4][i % 4] = sin(pi_halves * (i % MAX_CHANNELS) / MAX_CHANNELS); // atan(1) = pi / 4 so we get values between 0 and 1
+		}
+	}
+
+	void setSampleRate(float sampleRate) {
+		this->sampleRate = sampleRate;
+		pitch.Init(sampleRate);
+		setCullHoldTime(cullHoldTime);
+	}
+
+	/** Switches oscillator engines. The first switch to the wavetable engine
+	 *  builds the shared tables, so call this off the audio thread. The
+	 *  audio thread leaves the table banks alone until it sees the engine
+	 *  switched, and the release store of engine makes them visible to it
+	 *  before it renders from them.
+	 */
+	void setEngine(int engine) {
+		if (engine == WAVETABLE_ENGINE && !tablesReady) {
+			for (int i = 0; i < MAX_BANKS; i++) {
+				SAWtable[i].Init(sampleRate);
+				SQRtable[i].Init(sampleRate);
+				SAWtable[i].SetWaveshape(0.f);
+				SQRtable[i].SetWaveshape(1.f);
+			}
+			tablesReady = true;
+		}
+		this->engine.store(engine, std::memory_order_release);
+	}
+
+	/** Voices whose gain has been silent for this many seconds stop
+	 *  rendering until it comes back. 0 turns culling off.
+	 */
+	void setCullHoldTime(float seconds) {
+		cullHoldTime = seconds;
+		cullHoldSamples = std::max(1.f, seconds * sampleRate);
+	}
+
+	/** Oscillators per voice, 1..MAX_UNISON, their detune spread in
+	 *  semitones either side of the voice's pitch and their pulse width
+	 *  spread either side of the voice's. Builds the layout here, off the
+	 *  audio thread, which takes it on its next sample and restarts each
+	 *  bank at the new phases the next time the bank renders.
+	 */
+	void setUnison(int voices, float detune, float pwSpread) {
+		int unison = std::max(1, std::min(voices, (int)MAX_UNISON));
+		layouts.publish(new UnisonLayout(unison, detune, pwSpread));
+	}
+
+	/** Renders one sample of both waveforms for every voice and returns the
+	 *  number of voices. Outputs are written in groups of four.
+	 */
+	int process(const PolyInput& voct, const PolyInput& aft, const PolyInput& gainIn, float gainParam, float* sawOut, float* sqrOut) {
+		CableVoices voices = {voct, aft, gainIn, pitch};
+		return dispatchVoices(voices, gainParam, sawOut, sqrOut);
+	}
+
+	/** Same as process() for the voices of a Polyfotz bus. Past
+	 *  MAX_CHANNELS voices, voice v is added onto output channel
+	 *  v % MAX_CHANNELS, and all MAX_CHANNELS are returned.
+	 */
+	int processBus(const VoiceBusMessage& bus, float gainParam, float* sawOut, float* sqrOut) {
+		using namespace rack::simd;
+		BusVoices voices = {bus};
+		int channels = voices.channels();
+		if (channels <= MAX_CHANNELS)
+			return dispatchVoices(voices, gainParam, sawOut, sqrOut);
+
+		dispatchVoices(voices, gainParam, foldSaw, foldSqr);
+		for (int c = 0; c < MAX_CHANNELS; c += 4) {
+			float_4 saw = float_4::load(foldSaw + c);
+			float_4 sqr = float_4::load(foldSqr + c);
+			for (int v = c + MAX_CHANNELS; v < channels; v += MAX_CHANNELS) {
+				float_4 live = float_4(v, v + 1, v + 2, v + 3) < (float)channels;
+				saw += live & float_4::load(foldSaw + v);
+				sqr += live & float_4::load(foldSqr + v);
+			}
+			saw.store(sawOut + c);
+			sqr.store(sqrOut + c);
+		}
+		return MAX_CHANNELS;
+	}
+
+	/** renderVoices() in the build CpuDispatch selected.
+	 */
+	template <typename Voices>
+	int dispatchVoices(const Voices& voices, float gainParam, float* sawOut, float* sqrOut) {
+#if NB_CPU_DISPATCH
+		if (CpuDispatch::level() == CpuDispatch::AVX2)
+			return renderVoicesAvx2(voices, gainParam, sawOut, sqrOut);
+#endif
+		return renderVoices(voices, gainParam, sawOut, sqrOut);
+	}
+
+#if NB_CPU_DISPATCH
+	template <typename Voices>
+	NB_TARGET_AVX2 int renderVoicesAvx2(const Voices& voices, float gainParam, float* sawOut, float* sqrOut) {
+		return renderVoices(voices, gainParam, sawOut, sqrOut);
+	}
+#endif
+
+	/** Picks the voice loop for the unison setting and engine.
+	 */
+	template <typename Voices>
+	int renderVoices(const Voices& voices, float gainParam, float* sawOut, float* sqrOut) {
+		int engine = this->engine.load(std::memory_order_acquire);
+		if (layouts.acquire())
+			layoutGeneration++;
+		int* generation = bankGeneration[engine];
+		if (layouts.active->unison > 1) {
+			if (engine == WAVETABLE_ENGINE)
+				return renderUnison(SAWtable, SQRtable, generation, voices, gainParam, sawOut, sqrOut);
+			return renderUnison(SAWosc, SQRosc, generation, voices, gainParam, sawOut, sqrOut);
+		}
+		if (engine == WAVETABLE_ENGINE)
+			return render(SAWtable, SQRtable, generation, voices, gainParam, sawOut, sqrOut);
+		return render(SAWosc, SQRosc, generation, voices, gainParam, sawOut, sqrOut);
+	}
+
+	/** Restarts a bank at the current layout's phases if it has not been
+	 *  since the layout changed, and resyncs it if it was culled.
+	 */
+	template <typename SawBank, typename SqrBank>
+	void restartBank(SawBank& saw, SqrBank& sqr, int* generation, int b) {
+		if (generation[b] != layoutGeneration) {
+			saw.SetPhase(layouts.active->phase[b]);
+			sqr.SetPhase(layouts.active->phase[b]);
+			generation[b] = layoutGeneration;
+			culled[b] = true;
+		}
+		if (culled[b]) {
+			saw.Resync();
+			sqr.Resync();
+			culled[b] = false;
+		}
+	}
+
+	/** The voice loop for either engine. A group whose voices have all been
+	 *  silent for the hold time only advances its phases and outputs 0 V,
+	 *  and resyncs when any gain comes back.
+	 */
+	template <typename SawBank, typename SqrBank, typename Voices>
+	int render(SawBank* saw, SqrBank* sqr, int* generation, const Voices& voices, float gainParam, float* sawOut, float* sqrOut) {
+		using namespace rack::simd;
+		int channels = voices.channels();
+		bool gainConnected = voices.gainConnected();
+		bool culling = gainConnected && cullHoldTime > 0.f;
+		for (int c = 0; c < channels; c += 4) {
+			float_4 freq = voices.phaseIncrement(c);
+			float_4 gain = gainConnected ? 10.f - (10.f - voices.gain(c)) * gainParam : 10.f;
+			if (culling) {
+				// lanes past the channel count never hold a group up
+				float_4 silent = (fabs(gain) < CULL_THRESHOLD) | (float_4(c, c + 1, c + 2, c + 3) >= (float)channels);
+				silentSamples[c / 4] = ifelse(silent, fmin(silentSamples[c / 4] + 1.f, cullHoldSamples), 0.f);
+				if (movemask(silentSamples[c / 4] >= cullHoldSamples) == 0xf) {
+					saw[c / 4].SetPhaseIncrement(freq);
+					sqr[c / 4].SetPhaseIncrement(freq);
+					saw[c / 4].Advance();
+					sqr[c / 4].Advance();
+					culled[c / 4] = true;
+					float_4::zero().store(sawOut + c);
+					float_4::zero().store(sqrOut + c);
+					continue;
+				}
+			}
+			float_4 pw = voices.pwm(c);
+			saw[c / 4].SetPhaseIncrement(freq);
+			saw[c / 4].SetPW((pw + 1.f) / 2.f);
+			sqr[c / 4].SetPhaseIncrement(freq);
+			sqr[c / 4].SetPW( (pw * aft_amt[c / 4] + 1.f) / 2.f );
+			restartBank(saw[c / 4], sqr[c / 4], generation, c / 4);
+			(saw[c / 4].Process() * gain).store(sawOut + c);
+			(sqr[c / 4].Process() * gain).store(sqrOut + c);
+		}
+		return channels;
+	}
+
+	/** The voice loop in unison mode. Per voice values are worked out four
+	 *  voices at a time as in render(), then every bank gathers the values
+	 *  of the voices its lanes belong to, applies its lanes' detune and
+	 *  pulse width offsets and adds its output back onto those voices.
+	 *  Packing the oscillators densely keeps every lane busy whatever the
+	 *  voice and unison counts. A bank is culled once all its voices are.
+	 */
+	template <typename SawBank, typename SqrBank, typename Voices>
+	int renderUnison(SawBank* saw, SqrBank* sqr, int* generation, const Voices& voices, float gainParam, float* sawOut, float* sqrOut) {
+		using namespace rack::simd;
+		const UnisonLayout& layout = *layouts.active;
+		int channels = voices.channels();
+		bool gainConnected = voices.gainConnected();
+		bool culling = gainConnected && cullHoldTime > 0.f;
+		for (int c = 0; c < channels; c += 4) {
+			float_4 gain = gainConnected ? 10.f - (10.f - voices.gain(c)) * gainParam : 10.f;
+			if (culling) {
+				float_4 silent = (fabs(gain) < CULL_THRESHOLD) | (float_4(c, c + 1, c + 2, c + 3) >= (float)channels);
+				silentSamples[c / 4] = ifelse(silent, fmin(silentSamples[c / 4] + 1.f, cullHoldSamples), 0.f);
+				ifelse(silentSamples[c / 4] >= cullHoldSamples, 1.f, 0.f).store(voiceHeld + c);
+			}
+			float_4 pw = voices.pwm(c);
+			voices.phaseIncrement(c).store(voiceFreq + c);
+			((pw + 1.f) / 2.f).store(voiceSawPw + c);
+			((pw * aft_amt[c / 4] + 1.f) / 2.f).store(voiceSqrPw + c);
+			(gain * layout.gain).store(voiceGain + c);
+			float_4::zero().store(sawOut + c);
+			float_4::zero().store(sqrOut + c);
+		}
+
+		int banks = (channels * layout.unison + 3) / 4;
+		for (int b = 0; b < banks; b++) {
+			const int* v = layout.laneVoice + b * 4;
+			float_4 freq = float_4(voiceFreq[v[0]], voiceFreq[v[1]], voiceFreq[v[2]], voiceFreq[v[3]]) * layout.ratio[b];
+			if (culling && voiceHeld[v[0]] + voiceHeld[v[1]] + voiceHeld[v[2]] + voiceHeld[v[3]] == 4.f) {
+				saw[b].SetPhaseIncrement(freq);
+				sqr[b].SetPhaseIncrement(freq);
+				saw[b].Advance();
+				sqr[b].Advance();
+				culled[b] = true;
+				continue;
+			}
+			saw[b].SetPhaseIncrement(freq);
+			saw[b].SetPW(float_4(voiceSawPw[v[0]], voiceSawPw[v[1]], voiceSawPw[v[2]], voiceSawPw[v[3]]) + layout.pwOffset[b]);
+			sqr[b].SetPhaseIncrement(freq);
+			sqr[b].SetPW(float_4(voiceSqrPw[v[0]], voiceSqrPw[v[1]], voiceSqrPw[v[2]], voiceSqrPw[v[3]]) + layout.pwOffset[b]);
+			restartBank(saw[b], sqr[b], generation, b);
+			float_4 gain = float_4(voiceGain[v[0]], voiceGain[v[1]], voiceGain[v[2]], voiceGain[v[3]]);
+			float_4 sawSum = saw[b].Process() * gain;
+			float_4 sqrSum = sqr[b].Process() * gain;
+			for (int lane = 0; lane < 4; lane++) {
+				sawOut[v[lane]] += sawSum[lane];
+				sqrOut[v[lane]] += sqrSum[lane];
+			}
+		}
+		return channels;
+	}
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include <simd/functions.hpp>
+
+/** What Polyfotz hands a VarTriSaw placed directly to its right, through
+ *  Rack's expander messages instead of cables. VarTriSaw owns two of these
+ *  as its left expander's producer and consumer messages, Polyfotz fills
+ *  the producer each sample and Rack swaps them at the end of the sample.
+ *
+ *  The voices come ready to render: pitch already converted to phase
+ *  increments, and every note's full voicing, so a bus carries up to
+ *  MAX_VOICES voices where cables stop at 16. Lanes past voices in the
+ *  last group of four are unspecified.
+ */
+struct VoiceBusMessage {
+	typedef rack::simd::float_4 float_4;
+	static const int MAX_VOICES = 64;
+
+	int voices = 0;
+	// cycles per sample
+	float_4 phaseIncrement[MAX_VOICES / 4];
+	// aftertouch scaled to -1..1, the receiver shapes it into pulse widths
+	float_4 pwm[MAX_VOICES / 4];
+	// 0..10 V, like Polyfotz's gain output
+	float_4 gain[MAX_VOICES / 4];
+};
@@ -0,0 +1,76 @@
+#pragma once
+#include <algorithm>
+#include "objectswap.h"
+#include "voicinglibrary.h"
+
+/** Polyfotz's voicings in one flat block: semitone offsets per voice, up
+ *  to MAX_VOICES voices per voicing and MAX_VOICINGS voicings. Never
+ *  resized, so the audio thread can index it without allocating.
+ *
+ *  When library is set, the accessors read its voicings instead. The
+ *  bank holds a reference, so the mapping outlives every bank that uses it.
+ */
+struct VoicingBank {
+	static const int MAX_VOICINGS = 64;
+	static const int MAX_VOICES = 16;
+
+	int offsets[MAX_VOICINGS][MAX_VOICES] = {};
+	int sizes[MAX_VOICINGS] = {};
+	int count = 0;
+	std::shared_ptr<const VoicingLibrary> library;
+
+	/** The factory voicings, same as presets/Polyfotz/00_generic.vcvm.
+	 */
+	VoicingBank() {
+		static const int defaults[][4] = { {0, -5, -10, -12},
+						{0, -5, -10, -20},
+						{0, -3, -8, -19},
+						{0, -3, -7, -10},
+						{0, -4, -9, -11},
+						{0, -3, -8, -11},
+						{0, -5, -7, -11},
+						{0, -5, -11, -15},
+						{0, -3, -6, -9},
+						{0, -4, -8, -12},
+						};
+		for (const int* voicing : defaults) {
+			add(voicing, 4);
+		}
+	}
+
+	void clear() {
+		count = 0;
+	}
+
+	/** Appends a voicing, dropping voices past MAX_VOICES. Returns false
+	 *  when the bank is full.
+	 */
+	bool add(const int* voices, int size) {
+		if (count >= MAX_VOICINGS)
+			return false;
+		size = size < MAX_VOICES ? size : MAX_VOICES;
+		for (int i = 0; i < size; i++) {
+			offsets[count][i] = voices[i];
+		}
+		sizes[count] = size;
+		count++;
+		return true;
+	}
+
+	int voicings() const {
+		return library ? library->count() : count;
+	}
+
+	int size(int voicing) const {
+		return library ? std::min(library->size(voicing), (int)MAX_VOICES) : sizes[voicing];
+	}
+
+	int offset(int voicing, int voice) const {
+		return library ? library->voices(voicing)[voice] : offsets[voicing][voice];
+	}
+};
+
+/** Hands VoicingBanks from the UI thread to the audio thread, see
+ *  ObjectSwap.
+ */
+typedef ObjectSwap<VoicingBank> VoicingBankSwap;
@@ -0,0 +1,200 @@
+#include "voicinglibrary.h"
+#include <cstring>
+#include <map>
+#include <mutex>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+std::shared_ptr<const VoicingLibrary> VoicingLibrary::open(const std::string& path, std::string* error) {
+	// weak, so a library is unmapped once the last instance lets go of it
+	static std::mutex mutex;
+	static std::map<std::string, std::weak_ptr<const VoicingLibrary>> cache;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_ptr<const VoicingLibrary> shared = cache[path].lock();
+	if (shared)
+		return shared;
+
+	std::shared_ptr<VoicingLibrary> library(new VoicingLibrary);
+	if (!library->map(path, error) || !library->validate(error))
+		return nullptr;
+	cache[path] = library;
+	return library;
+}
+
+
+std::vector<uint8_t> VoicingLibrary::build(const std::vector<std::vector<int>>& voicings) {
+	Header header;
+	std::memcpy(header.magic, "NBVL", 4);
+	header.version = VERSION;
+	header.count = voicings.size();
+	std::vector<uint32_t> index;
+	std::vector<int8_t> voices;
+	for (const std::vector<int>& voicing : voicings) {
+		index.push_back(voices.size());
+		for (int voice : voicing) {
+			voices.push_back(voice < -128 ? -128 : voice > 127 ? 127 : voice);
+		}
+	}
+	index.push_back(voices.size());
+	header.voicesSize = voices.size();
+
+	std::vector<uint8_t> data(sizeof(header) + index.size() * sizeof(uint32_t) + voices.size());
+	uint8_t* p = data.data();
+	std::memcpy(p, &header, sizeof(header));
+	p += sizeof(header);
+	std::memcpy(p, index.data(), index.size() * sizeof(uint32_t));
+	p += index.size() * sizeof(uint32_t);
+	if (!voices.empty())
+		std::memcpy(p, voices.data(), voices.size());
+	return data;
+}
+
+
+#if defined(_WIN32)
+
+VoicingLibrary::~VoicingLibrary() {
+	if (locked_)
+		VirtualUnlock((LPVOID) data_, dataSize_);
+	if (data_)
+		UnmapViewOfFile(data_);
+	if (handle_)
+		CloseHandle(handle_);
+}
+
+bool VoicingLibrary::map(const std::string& path, std::string* error) {
+	path_ = path;
+	int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+	std::vector<wchar_t> pathW(length > 0 ? length : 1);
+	MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, pathW.data(), length);
+	HANDLE file = CreateFileW(pathW.data(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		if (error)
+			*error = "Could not open " + path;
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(Header)) {
+		CloseHandle(file);
+		if (error)
+			*error = path + " is too short for a voicing library";
+		return false;
+	}
+	// the mapping keeps the file alive, the file handle is not needed
+	handle_ = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!handle_) {
+		if (error)
+			*error = "Could not map " + path;
+		return false;
+	}
+	data_ = (const uint8_t*) MapViewOfFile(handle_, FILE_MAP_READ, 0, 0, 0);
+	if (!data_) {
+		if (error)
+			*error = "Could not map " + path;
+		return false;
+	}
+	dataSize_ = (size_t) size.QuadPart;
+	// keeps the audio thread from faulting on a page that was paged out,
+	// fails quietly past the working set limit, see validate()
+	locked_ = VirtualLock((LPVOID) data_, dataSize_) != 0;
+	return true;
+}
+
+#else
+
+VoicingLibrary::~VoicingLibrary() {
+	if (locked_)
+		munlock(data_, dataSize_);
+	if (data_)
+		munmap((void*) data_, dataSize_);
+}
+
+bool VoicingLibrary::map(const std::string& path, std::string* error) {
+	path_ = path;
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		if (error)
+			*error = "Could not open " + path;
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(Header)) {
+		close(fd);
+		if (error)
+			*error = path + " is too short for a voicing library";
+		return false;
+	}
+	int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+	flags |= MAP_POPULATE;
+#endif
+	void* data = mmap(NULL, st.st_size, PROT_READ, flags, fd, 0);
+	// the mapping keeps the file alive, the descriptor is not needed
+	close(fd);
+	if (data == MAP_FAILED) {
+		if (error)
+			*error = "Could not map " + path;
+		return false;
+	}
+	data_ = (const uint8_t*) data;
+	dataSize_ = st.st_size;
+	// keeps the audio thread from faulting on a page that was paged out,
+	// fails quietly past RLIMIT_MEMLOCK, see validate()
+	locked_ = mlock(data_, dataSize_) == 0;
+	return true;
+}
+
+#endif
+
+
+bool VoicingLibrary::validate(std::string* error) {
+	Header header;
+	std::memcpy(&header, data_, sizeof(header));
+	if (std::memcmp(header.magic, "NBVL", 4) != 0 || header.version != VERSION) {
+		if (error)
+			*error = path_ + " is not a version " + std::to_string(VERSION) + " voicing library";
+		return false;
+	}
+	size_t indexSize = ((size_t) header.count + 1) * sizeof(uint32_t);
+	if (header.count == 0 || header.count > (uint32_t) INT32_MAX
+		|| dataSize_ - sizeof(header) < indexSize
+		|| dataSize_ - sizeof(header) - indexSize < header.voicesSize) {
+		if (error)
+			*error = path_ + " is truncated or empty";
+		return false;
+	}
+	index_ = (const uint32_t*) (data_ + sizeof(header));
+	voices_ = (const int8_t*) (data_ + sizeof(header) + indexSize);
+	if (index_[0] != 0 || index_[header.count] != header.voicesSize) {
+		if (error)
+			*error = path_ + " has a broken index";
+		return false;
+	}
+	for (uint32_t i = 0; i < header.count; i++) {
+		if (index_[i + 1] < index_[i]) {
+			if (error)
+				*error = path_ + " has a broken index";
+			return false;
+		}
+	}
+	count_ = header.count;
+
+	// locking faulted every page in. Without the lock, touching each page
+	// is only best effort: the system may still page them out again
+	if (!locked_) {
+		volatile uint8_t sink = 0;
+		for (size_t i = 0; i < dataSize_; i += 4096) {
+			sink = data_[i];
+		}
+		(void) sink;
+	}
+	return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** A read-only file of Polyfotz voicings, memory-mapped once and shared by
+ *  every instance that loads the same path.
+ *
+ *  Layout, little-endian:
+ *
+ *      char     magic[4]           "NBVL"
+ *      uint32_t version            1
+ *      uint32_t count              number of voicings
+ *      uint32_t voicesSize         number of entries in voices
+ *      uint32_t index[count + 1]   start of each voicing in voices,
+ *                                  index[count] == voicesSize
+ *      int8_t   voices[voicesSize] semitone offsets, voicing after voicing
+ *
+ *  A voicing's size is the distance to the next index entry, so looking
+ *  one up is two loads. open() checks the whole index, after that the
+ *  accessors trust it.
+ */
+class VoicingLibrary {
+public:
+	static const uint32_t VERSION = 1;
+
+	/** Maps path, or hands out the mapping another instance already holds.
+	 *  Returns null and sets error when the file cannot be mapped or is
+	 *  not a valid library. Not for the audio thread.
+	 */
+	static std::shared_ptr<const VoicingLibrary> open(const std::string& path, std::string* error = nullptr);
+
+	/** Serializes voicings into the format above. Voices outside int8_t
+	 *  are clamped.
+	 */
+	static std::vector<uint8_t> build(const std::vector<std::vector<int>>& voicings);
+
+	~VoicingLibrary();
+	VoicingLibrary(const VoicingLibrary&) = delete;
+	VoicingLibrary& operator=(const VoicingLibrary&) = delete;
+
+	int count() const {
+		return count_;
+	}
+
+	int size(int voicing) const {
+		return (int)(index_[voicing + 1] - index_[voicing]);
+	}
+
+	const int8_t* voices(int voicing) const {
+		return voices_ + index_[voicing];
+	}
+
+	const std::string& path() const {
+		return path_;
+	}
+
+private:
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		uint32_t count;
+		uint32_t voicesSize;
+	};
+
+	std::string path_;
+	const uint8_t* data_ = nullptr;
+	size_t dataSize_ = 0;
+	// platform handle kept open for the mapping's lifetime, if any
+	void* handle_ = nullptr;
+	// the pages are locked in RAM, see map()
+	bool locked_ = false;
+	int count_ = 0;
+	const uint32_t* index_ = nullptr;
+	const int8_t* voices_ = nullptr;
+
+	VoicingLibrary() {}
+	bool map(const std::string& path, std::string* error);
+	bool validate(std::string* error);
+};
@@ -0,0 +1,336 @@
+#pragma once
+#include <cmath>
+#include <complex>
+#include <vector>
+#include <simd/functions.hpp>
+
+/** Band-limited single cycles of VariableShapeOscillator's two corner
+ *  shapes, the variable triangle/saw (waveshape 0) and the pulse
+ *  (waveshape 1), sampled at kNumPW pulse widths.
+ *
+ *  Every shape and pulse width has kNumLevels mip levels, one per octave
+ *  of phase increment. Level k holds the harmonics that stay below
+ *  Nyquist up to an increment of kBaseIncrement * 2^k, so the tables do
+ *  not depend on the sample rate. Higher levels need fewer samples.
+ *  Each table carries one guard sample so interpolation never wraps.
+ *
+ *  Every table holds at least 16 samples per cycle of its highest
+ *  harmonic. WavetableOscillatorBank interpolates linearly, and with only
+ *  4 the images of the top harmonics came back into the audible band
+ *  louder than polyBLEP's aliasing, see kMaxTableSize.
+ */
+class BandLimitedTables
+{
+public:
+    static const int kNumShapes     = 2;
+    static const int kNumPW         = 33;
+    static const int kNumLevels     = 9;
+    static const int kMaxTableSize  = 8192;
+    static const int kMinTableSize  = 256;
+    // first level at kMinTableSize, log2(kMaxTableSize / kMinTableSize)
+    static const int kMinTableSizeLevel = 5;
+    static constexpr float kBaseIncrement = 1.f / 1024.f;
+
+    /** Built on first use and shared read-only by every oscillator. Call
+     *  it once off the audio thread, building takes a moment.
+     */
+    static const BandLimitedTables& Get()
+    {
+        static const BandLimitedTables tables;
+        return tables;
+    }
+
+    static int TableSize(int level)
+    {
+        int size = kMaxTableSize >> level;
+        return size < kMinTableSize ? kMinTableSize : size;
+    }
+
+    const float* Table(int shape, int pw_index, int level) const
+    {
+        return &data_[(shape * kNumPW + pw_index) * stride_ + offsets_[level]];
+    }
+
+    /** Distance from a table to the same level at the next pulse width.
+     */
+    int PWStride() const
+    {
+        return stride_;
+    }
+
+    /** Offset of a level's table from the first level's.
+     */
+    int LevelOffset(int level) const
+    {
+        return offsets_[level];
+    }
+
+    const float* Data() const
+    {
+        return data_.data();
+    }
+
+private:
+    std::vector<float> data_;
+    int                offsets_[kNumLevels];
+    int                stride_;
+
+    BandLimitedTables()
+    {
+        stride_ = 0;
+        for(int level = 0; level < kNumLevels; level++)
+        {
+            offsets_[level] = stride_;
+            stride_ += TableSize(level) + 1;
+        }
+        data_.resize(kNumShapes * kNumPW * stride_);
+
+        std::vector<std::complex<double>> coefs;
+        for(int shape = 0; shape < kNumShapes; shape++)
+        {
+            for(int j = 0; j < kNumPW; j++)
+            {
+                double pw  = (double)j / (kNumPW - 1);
+                double dc  = ComputeCoefficients(shape, pw, &coefs);
+                for(int level = 0; level < kNumLevels; level++)
+                {
+                    int harmonics = (int)(0.5 / (kBaseIncrement * (1 << level)));
+                    Synthesize(coefs,
+                               dc,
+                               harmonics,
+                               TableSize(level),
+                               &data_[(shape * kNumPW + j) * stride_
+                                      + offsets_[level]]);
+                }
+            }
+        }
+    }
+
+    /** Fourier series of the naive 0..1 waveform, c[n - 1] for harmonic n
+     *  up to the level 0 limit. Both shapes are piecewise linear, so each
+     *  coefficient is a sum over the breakpoints t of
+     *  e^(-2 pi i n t) * (jump / (2 pi i n) + slope change / (2 pi i n)^2).
+     *  Returns the mean.
+     */
+    static double ComputeCoefficients(int                                shape,
+                                      double                             pw,
+                                      std::vector<std::complex<double>>* coefs)
+    {
+        struct Breakpoint
+        {
+            double t, jump, slope_change;
+        };
+        Breakpoint breakpoints[2];
+        double     dc;
+        if(shape == 0)
+        {
+            // rises to 1 at pw and falls back to 0, a saw at either end
+            if(pw <= 0.0)
+            {
+                breakpoints[0] = {0.0, 1.0, 0.0};
+                breakpoints[1] = {0.0, 0.0, 0.0};
+            }
+            else if(pw >= 1.0)
+            {
+                breakpoints[0] = {0.0, -1.0, 0.0};
+                breakpoints[1] = {0.0, 0.0, 0.0};
+            }
+            else
+            {
+                double corner  = 1.0 / pw + 1.0 / (1.0 - pw);
+                breakpoints[0] = {0.0, 0.0, corner};
+                breakpoints[1] = {pw, 0.0, -corner};
+            }
+            dc = 0.5;
+        }
+        else
+        {
+            // low below pw, high above
+            breakpoints[0] = {0.0, -1.0, 0.0};
+            breakpoints[1] = {pw, 1.0, 0.0};
+            dc             = 1.0 - pw;
+        }
+
+        const int harmonics = (int)(0.5 / kBaseIncrement);
+        coefs->assign(harmonics, 0.0);
+        for(int n = 1; n <= harmonics; n++)
+        {
+            std::complex<double> s(0.0, 2.0 * M_PI * n);
+            std::complex<double> c(0.0, 0.0);
+            for(const Breakpoint& b : breakpoints)
+            {
+                c += std::polar(1.0, -2.0 * M_PI * n * b.t)
+                     * (b.jump / s + b.slope_change / (s * s));
+            }
+            (*coefs)[n - 1] = c;
+        }
+        return dc;
+    }
+
+    /** Sums the first harmonics of the series into size + 1 samples, scaled
+     *  to -1..1 like VariableShapeOscillator. Each harmonic is a phasor
+     *  rotated one step per sample instead of a sin() call; the inner loop
+     *  runs across harmonics so the rotations are independent.
+     */
+    static void Synthesize(const std::vector<std::complex<double>>& coefs,
+                           double                                   dc,
+                           int                                      harmonics,
+                           int                                      size,
+                           float*                                   out)
+    {
+        std::vector<double> re(harmonics), im(harmonics);
+        std::vector<double> step_re(harmonics), step_im(harmonics);
+        for(int n = 0; n < harmonics; n++)
+        {
+            re[n]      = 2.0 * coefs[n].real();
+            im[n]      = 2.0 * coefs[n].imag();
+            step_re[n] = std::cos(2.0 * M_PI * (n + 1) / size);
+            step_im[n] = std::sin(2.0 * M_PI * (n + 1) / size);
+        }
+        for(int i = 0; i < size; i++)
+        {
+            double sum = dc;
+            for(int n = 0; n < harmonics; n++)
+            {
+                sum += re[n];
+                const double next_re = re[n] * step_re[n] - im[n] * step_im[n];
+                im[n]                = re[n] * step_im[n] + im[n] * step_re[n];
+                re[n]                = next_re;
+            }
+            out[i] = (float)(2.0 * sum - 1.0);
+        }
+        out[size] = out[0];
+    }
+};
+
+/** Drop-in alternative to VariableShapeOscillatorBank for waveshape 0 or 1
+ *  that reads BandLimitedTables instead of evaluating BLEPs: per lane, a
+ *  linear interpolation in the mip level that fits the lane's frequency,
+ *  crossfaded between the two nearest pulse widths. Table offsets are
+ *  worked out in the setters so Process() is four gathers and vector math.
+ */
+class WavetableOscillatorBank
+{
+public:
+    typedef rack::simd::float_4 float_4;
+    typedef rack::simd::int32_4 int32_4;
+
+    WavetableOscillatorBank() {}
+    ~WavetableOscillatorBank() {}
+
+    void Init(float sample_rate)
+    {
+        tables_      = &BandLimitedTables::Get();
+        sample_rate_ = sample_rate;
+        phase_       = 0.0f;
+        SetWaveshape(0.f);
+        SetFreq(440.f);
+        SetPW(0.5f);
+    }
+
+    float_4 Process()
+    {
+        using namespace rack::simd;
+        phase_ += frequency_;
+        phase_ -= floor(phase_);
+
+        const float_4 pos   = phase_ * size_;
+        const float_4 index = floor(pos);
+        const float_4 frac  = pos - index;
+        const int32_4 start
+            = int32_4(index) + level_offset_ + pw_offset_ + int32_4(shape_offset_);
+
+        const float* data   = tables_->Data();
+        const int    stride = tables_->PWStride();
+        float_4      low0, low1, high0, high1;
+        for(int lane = 0; lane < 4; lane++)
+        {
+            const float* t = data + start[lane];
+            low0[lane]     = t[0];
+            low1[lane]     = t[1];
+            high0[lane]    = t[stride];
+            high1[lane]    = t[stride + 1];
+        }
+        const float_4 low  = low0 + (low1 - low0) * frac;
+        const float_4 high = high0 + (high1 - high0) * frac;
+        return low + (high - low) * pw_frac_;
+    }
+
+    void Advance()
+    {
+        phase_ += frequency_;
+        phase_ -= rack::simd::floor(phase_);
+    }
+
+    /** Nothing to resync, tables have no edge state.
+     */
+    void Resync() {}
+
+    void SetPhase(float_4 phase)
+    {
+        phase_ = phase - rack::simd::floor(phase);
+    }
+
+    void SetFreq(float_4 frequency)
+    {
+        SetPhaseIncrement(frequency / sample_rate_);
+    }
+
+    void SetPhaseIncrement(float_4 frequency)
+    {
+        using namespace rack::simd;
+        frequency_ = fmin(frequency, .25f);
+        // lowest level whose harmonics stay below Nyquist at this rate, one
+        // above the exponent of the increment in units of kBaseIncrement
+        const int32_4 bits = int32_4::cast(
+            frequency_ * (1.f / BandLimitedTables::kBaseIncrement));
+        const float_4 level = fmin(
+            fmax(float_4(((bits >> 23) & int32_4(0xff)) - int32_4(126)), 0.f),
+            BandLimitedTables::kNumLevels - 1);
+        // 2^-level, TableSize() and the sum of the sizes below, without
+        // leaving the vector unit
+        const float_4 scale
+            = float_4::cast((int32_4(127) - int32_4(level)) << 23);
+        const float_4 min_level = BandLimitedTables::kMinTableSizeLevel;
+        const float_4 halving   = fmin(level, min_level);
+        const float_4 halving_scale
+            = float_4::cast((int32_4(127) - int32_4(halving)) << 23);
+        size_ = fmax(BandLimitedTables::kMaxTableSize * scale,
+                     (float)BandLimitedTables::kMinTableSize);
+        level_offset_ = int32_4(
+            2.f * BandLimitedTables::kMaxTableSize * (1.f - halving_scale)
+            + halving
+            + (level - halving) * (BandLimitedTables::kMinTableSize + 1.f));
+    }
+
+    void SetPW(float_4 pw)
+    {
+        using namespace rack::simd;
+        const float_4 pos
+            = fmin(fmax(pw, 0.f), 1.f) * (BandLimitedTables::kNumPW - 1);
+        const float_4 index = fmin(floor(pos), BandLimitedTables::kNumPW - 2);
+        pw_frac_            = pos - index;
+        pw_offset_ = int32_4(index * (float)tables_->PWStride());
+    }
+
+    /** 0 for the triangle/saw tables, 1 for the pulse tables. Only lane 0
+     *  is used, a bank renders one shape.
+     */
+    void SetWaveshape(float_4 waveshape)
+    {
+        shape_offset_ = tables_->Table(waveshape[0] >= 0.5f ? 1 : 0, 0, 0)
+                        - tables_->Data();
+    }
+
+private:
+    const BandLimitedTables* tables_;
+    float                    sample_rate_;
+
+    float_4 phase_;
+    float_4 frequency_;
+    float_4 size_;
+    float_4 pw_frac_;
+    int32_4 level_offset_;
+    int32_4 pw_offset_;
+    int     shape_offset_;
+};
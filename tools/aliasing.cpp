@@ -0,0 +1,315 @@
+/** Alias rejection against CPU cost for every oscillator engine and
+ *  saturation mode.
+ *
+ * Build and run with `make aliasing`. Prints one CSV row per module, mode
+ * and setting:
+ *   module,mode,freq,pw,gain,hardness,alias_db,audible_alias_db,worst_alias_db,ns_per_sample
+ * VarTriSaw plays voice 16 at freq Hz with aftertouch 0, 5 and 10 V, once
+ * per engine, and reports both outputs of the same render, each with the
+ * pulse width its oscillator plays as pw. Each voice's square takes its
+ * own share of the aftertouch, see VarTriSawCore::aft_amt, and voice 16's
+ * is the largest. The other 15 voices are silenced through the gain input
+ * and culled, so they only advance their phases. Softclip shapes a 5 V sine at freq Hz, multiplied by gain,
+ * once per saturation, oversampling and ADAA mode. Columns that do not
+ * apply to a module are empty.
+ *
+ * Every wanted component sits on a harmonic of freq, so the render's
+ * spectrum is split into harmonic bins and the rest. The pitches are C
+ * notes, whose harmonics never alias onto each other at the sample rate
+ * the way those of 1 kHz at 48 kHz would. alias_db is the
+ * power of the rest against that of the harmonics, audible_alias_db the
+ * same for the rest below AUDIBLE_LIMIT only, where polyBLEP's aliases
+ * near Nyquist do not count, and worst_alias_db the loudest single bin of
+ * the rest against the loudest harmonic. All in dB, lower is cleaner.
+ * They stay empty, with a warning, where the harmonics lie too close
+ * together for the window to tell them from the rest, which happens for
+ * low pitches with a small --size.
+ * The spectrum is a 7-term Blackman-Harris windowed FFT, whose leakage
+ * stays below about -160 dB. ns_per_sample is the
+ * fastest of the timed renders of the same setting, for the whole
+ * process() call. Options:
+ *   --size N       FFT length and samples analyzed, a power of two
+ *                  (default 65536)
+ *   --repeats N    timed renders per setting, the first one is analyzed
+ *                  (default 3)
+ *   --only NAME    only sweep one module
+ *   --cpu LEVEL    kernel build to run, baseline or avx2 (default: the best
+ *                  the CPU has), see src/cpudispatch.h
+ */
+#include <complex>
+#include <cstdlib>
+#include <memory>
+#include "harness.hpp"
+#include "softclipcore.h"
+#include "vartrisawcore.h"
+
+using namespace harness;
+
+static int fftSize = 65536;
+static int repeats = 3;
+// rendered and dropped before the analyzed part, so filters and the
+// BLEP state have settled
+static const int WARMUP = 4096;
+// window main lobe half width in bins, plus a margin for the pitch error
+static const int LOBE = 9;
+static const float AUDIBLE_LIMIT = 15000.f;
+static std::string only;
+
+static bool selected(const char* module) {
+	return only.empty() || only == module;
+}
+
+/** In place radix-2 FFT, x.size() a power of two.
+ */
+static void fft(std::vector<std::complex<double>>& x) {
+	int n = x.size();
+	for (int i = 1, j = 0; i < n; i++) {
+		int bit = n >> 1;
+		for (; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j ^= bit;
+		if (i < j)
+			std::swap(x[i], x[j]);
+	}
+	for (int len = 2; len <= n; len <<= 1) {
+		std::complex<double> step = std::polar(1.0, -2.0 * M_PI / len);
+		for (int i = 0; i < n; i += len) {
+			std::complex<double> w = 1.0;
+			for (int k = 0; k < len / 2; k++) {
+				std::complex<double> a = x[i + k];
+				std::complex<double> b = x[i + k + len / 2] * w;
+				x[i + k] = a + b;
+				x[i + k + len / 2] = a - b;
+				w *= step;
+			}
+		}
+	}
+}
+
+struct Aliasing {
+	// false when the harmonics are too dense to separate, see measure()
+	bool valid;
+	double aliasDb;
+	double audibleAliasDb;
+	double worstAliasDb;
+};
+
+/** Splits the spectrum of samples into the harmonics of freq Hz, DC
+ *  included, and everything else.
+ */
+static Aliasing measure(const std::vector<float>& samples, double freq) {
+	static const double coefs[7] = {0.27105140069342, 0.43329793923448, 0.21812299954311, 0.06592544638803, 0.01081174209837, 0.00077658482522, 0.00001388721735};
+	int n = samples.size();
+	Aliasing a = {};
+	// with the window's main lobes touching, every bin would count as a
+	// harmonic and the rest come out as the floor
+	double binsPerHarmonic = freq * n / SAMPLE_RATE;
+	if (binsPerHarmonic <= 2 * LOBE + 1) {
+		static double warnedFreq = 0.0;
+		if (freq != warnedFreq)
+			std::fprintf(stderr, "%g Hz has %.1f bins per harmonic at --size %d, more than %d are needed, skipping its alias figures\n", freq, binsPerHarmonic, n, 2 * LOBE + 1);
+		warnedFreq = freq;
+		return a;
+	}
+	std::vector<std::complex<double>> x(n);
+	for (int i = 0; i < n; i++) {
+		double w = 0.0;
+		for (int k = 0; k < 7; k++) {
+			w += (k % 2 ? -1.0 : 1.0) * coefs[k] * std::cos(2.0 * M_PI * k * i / n);
+		}
+		x[i] = w * samples[i];
+	}
+	fft(x);
+
+	std::vector<bool> harmonic(n / 2 + 1, false);
+	for (double center = 0.0; center < n / 2 + LOBE; center += binsPerHarmonic) {
+		int low = std::max(0, (int)std::floor(center) - LOBE);
+		int high = std::min(n / 2, (int)std::ceil(center) + LOBE);
+		for (int b = low; b <= high; b++) {
+			harmonic[b] = true;
+		}
+	}
+
+	int audibleBins = (int)(AUDIBLE_LIMIT * n / SAMPLE_RATE);
+	double harmonicPower = 0.0, aliasPower = 0.0, audibleAliasPower = 0.0, loudestHarmonic = 0.0, loudestAlias = 0.0;
+	for (int b = 0; b <= n / 2; b++) {
+		double power = std::norm(x[b]);
+		if (harmonic[b]) {
+			harmonicPower += power;
+			loudestHarmonic = std::max(loudestHarmonic, power);
+		}
+		else {
+			aliasPower += power;
+			if (b < audibleBins)
+				audibleAliasPower += power;
+			loudestAlias = std::max(loudestAlias, power);
+		}
+	}
+	// a spectrum without a single alias bin would be -inf, report the floor
+	const double floor = 1e-30;
+	a.valid = true;
+	a.aliasDb = 10.0 * std::log10(std::max(aliasPower, floor) / std::max(harmonicPower, floor));
+	a.audibleAliasDb = 10.0 * std::log10(std::max(audibleAliasPower, floor) / std::max(harmonicPower, floor));
+	a.worstAliasDb = 10.0 * std::log10(std::max(loudestAlias, floor) / std::max(loudestHarmonic, floor));
+	return a;
+}
+
+/** The three alias columns, empty when they could not be measured.
+ */
+static std::string aliasColumns(const Aliasing& a) {
+	if (!a.valid)
+		return ",,";
+	char columns[64];
+	std::snprintf(columns, sizeof(columns), "%.1f,%.1f,%.1f", a.aliasDb, a.audibleAliasDb, a.worstAliasDb);
+	return columns;
+}
+
+/** Renders repeats times through render(i), which returns the analyzed
+ *  samples of frame i, from a fresh state made by reset() each time.
+ *  Keeps the first render and returns the fastest time per frame.
+ */
+template <typename Reset, typename Render>
+static double timeRenders(Reset reset, Render render) {
+	double best = 0.0;
+	for (int r = 0; r < repeats; r++) {
+		reset();
+		auto start = std::chrono::steady_clock::now();
+		for (long i = 0; i < WARMUP + fftSize; i++) {
+			render(i, r == 0 && i >= WARMUP);
+		}
+		auto end = std::chrono::steady_clock::now();
+		double ns = std::chrono::duration<double, std::nano>(end - start).count() / (WARMUP + fftSize);
+		best = r == 0 ? ns : std::min(best, ns);
+	}
+	return best;
+}
+
+static void sweepVarTriSaw() {
+	static const char* engineNames[VarTriSawCore::ENGINES_LEN] = {"blep", "wavetable"};
+	// the voice whose square takes the most of the aftertouch
+	static const int VOICE = MAX_CHANNELS - 1;
+	for (int engine = 0; engine < VarTriSawCore::ENGINES_LEN; engine++) {
+		for (float voctVoltage : {-2.f, 0.f, 2.f, 3.f, 4.f, 5.f}) {
+			for (float aftVoltage : {0.f, 5.f, 10.f}) {
+				std::unique_ptr<VarTriSawCore> core;
+				std::vector<float> saw, sqr;
+				Frame voctVoltages, aftVoltages, gainVoltages;
+				for (int c = 0; c < MAX_CHANNELS; c++) {
+					voctVoltages.voltages[c] = voctVoltage;
+					aftVoltages.voltages[c] = aftVoltage;
+				}
+				gainVoltages.voltages[VOICE] = 10.f;
+				VarTriSawCore::PolyInput voct = {voctVoltages.voltages, MAX_CHANNELS};
+				VarTriSawCore::PolyInput aft = {aftVoltages.voltages, MAX_CHANNELS};
+				VarTriSawCore::PolyInput gainIn = {gainVoltages.voltages, MAX_CHANNELS};
+				Frame sawOut, sqrOut;
+				double ns = timeRenders([&]() {
+					core.reset(new VarTriSawCore);
+					core->init(SAMPLE_RATE);
+					core->setEngine(engine);
+					// the silent voices are culled well within the warmup
+					core->setCullHoldTime(.01f);
+				}, [&](long i, bool keep) {
+					core->process(voct, aft, gainIn, 1.f, sawOut.voltages, sqrOut.voltages);
+					if (keep) {
+						saw.push_back(sawOut.voltages[VOICE]);
+						sqr.push_back(sqrOut.voltages[VOICE]);
+					}
+				});
+				// the pitch the oscillators really play, after exp2Fast()
+				double freq = core->pitch.PhaseIncrement(rack::simd::float_4(voctVoltage))[0] * (double)SAMPLE_RATE;
+				// the pulse widths render() sets
+				float amount = aftVoltage / 10.f;
+				float sawPw = (amount + 1.f) / 2.f;
+				float sqrPw = (amount * core->aft_amt[VOICE / 4][VOICE % 4] + 1.f) / 2.f;
+				std::printf("VarTriSaw,%s-saw,%g,%.3f,,,%s,%.2f\n", engineNames[engine], freq, sawPw, aliasColumns(measure(saw, freq)).c_str(), ns);
+				std::printf("VarTriSaw,%s-sqr,%g,%.3f,,,%s,%.2f\n", engineNames[engine], freq, sqrPw, aliasColumns(measure(sqr, freq)).c_str(), ns);
+			}
+		}
+	}
+}
+
+static void sweepSoftclip() {
+	// the same modes as tools/bench.cpp
+	struct Mode {
+		const char* name;
+		int saturationMode;
+		int oversampling;
+		int adaa;
+	};
+	const Mode modes[] = {
+		{"exact", SoftclipCore::EXACT_SATURATION, 0, 0},
+		{"fast", SoftclipCore::FAST_SATURATION, 0, 0},
+		{"exact-os2x", SoftclipCore::EXACT_SATURATION, 1, 0},
+		{"exact-os4x", SoftclipCore::EXACT_SATURATION, 2, 0},
+		{"exact-os8x", SoftclipCore::EXACT_SATURATION, 3, 0},
+		{"fast-os2x", SoftclipCore::FAST_SATURATION, 1, 0},
+		{"fast-os4x", SoftclipCore::FAST_SATURATION, 2, 0},
+		{"fast-os8x", SoftclipCore::FAST_SATURATION, 3, 0},
+		{"adaa1", SoftclipCore::EXACT_SATURATION, 0, 1},
+		{"adaa2", SoftclipCore::EXACT_SATURATION, 0, 2},
+	};
+	for (const Mode& m : modes) {
+		for (float voctVoltage : {-1.f, 2.f, 4.f}) {
+			double freq = rack::dsp::FREQ_C4 * std::pow(2.0, voctVoltage);
+			for (float gain : {.2f, 1.f, 4.f}) {
+				for (float hardness : {0.f, .5f, .9f}) {
+					SoftclipCore core;
+					std::vector<float> out;
+					double phaseIncrement = freq / (double)SAMPLE_RATE;
+					Frame in, channelsOut;
+					double ns = timeRenders([&]() {
+						// the setters also clear the history of the last repeat
+						core.setSaturationMode(m.saturationMode);
+						core.setOversampling(m.oversampling);
+						core.setAdaa(m.adaa);
+					}, [&](long i, bool keep) {
+						// a phase in double, so the input itself is clean
+						in.voltages[0] = 5.f * (float)std::sin(2.0 * M_PI * std::fmod(i * phaseIncrement, 1.0));
+						float mix = core.process(in.voltages, channelsOut.voltages, 1, gain, hardness);
+						if (keep)
+							out.push_back(mix);
+					});
+					std::printf("Softclip,%s,%g,,%g,%g,%s,%.2f\n", m.name, freq, gain, hardness, aliasColumns(measure(out, freq)).c_str(), ns);
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	int cpuLevel = CpuDispatch::detect();
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--size" && i + 1 < argc) {
+			fftSize = std::atoi(argv[++i]);
+		}
+		else if (arg == "--repeats" && i + 1 < argc) {
+			repeats = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (arg == "--only" && i + 1 < argc) {
+			only = argv[++i];
+		}
+		else if (arg == "--cpu" && i + 1 < argc && CpuDispatch::parse(argv[i + 1]) >= 0) {
+			cpuLevel = CpuDispatch::parse(argv[++i]);
+		}
+		else {
+			std::fprintf(stderr, "usage: %s [--size N] [--repeats N] [--only MODULE] [--cpu baseline|avx2]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (fftSize < 1024 || (fftSize & (fftSize - 1))) {
+		std::fprintf(stderr, "--size has to be a power of two, 1024 or more\n");
+		return 1;
+	}
+	cpuLevel = CpuDispatch::select(cpuLevel);
+	std::fprintf(stderr, "kernels: %s\n", CpuDispatch::name(cpuLevel));
+
+	std::printf("module,mode,freq,pw,gain,hardness,alias_db,audible_alias_db,worst_alias_db,ns_per_sample\n");
+	if (selected("VarTriSaw"))
+		sweepVarTriSaw();
+	if (selected("Softclip"))
+		sweepSoftclip();
+	return 0;
+}
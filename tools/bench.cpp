@@ -0,0 +1,353 @@
+/** Headless micro-benchmarks of the plugin's DSP cores.
+ *
+ * Build and run with `make bench`. Prints one CSV row per module, variant,
+ * parameter value and channel count:
+ *   module,variant,param,value,channels,notes,ns_per_sample,samples_per_sec
+ * where channels are output channels, a sample is one engine frame over
+ * all of them, and notes is the number of notes played into Polyfotz, or
+ * empty for rows that do not play it. A Polyfotz row's channel count is
+ * the most its voicings reached during the run. Options:
+ *   --frames N     frames per timed run (default 65536)
+ *   --only NAME    only run the benchmarks of one module
+ *   --cpu LEVEL    kernel build to run, baseline or avx2 (default: the best
+ *                  the CPU has), see src/cpudispatch.h
+ */
+#include <cstdlib>
+#include "bench.hpp"
+#include "softclipcore.h"
+#include "mogglecore.h"
+#include "polyfotzcore.h"
+#include "variableshapeosc.h"
+#include "wavetableosc.h"
+
+using namespace harness;
+using rack::simd::float_4;
+
+long benchFrames = 65536;
+static std::string only;
+
+static bool selected(const char* module) {
+	return only.empty() || only == module;
+}
+
+void report(const char* module, const std::string& variant, const char* param, float value, int channels, double ns, int notes) {
+	std::string notesColumn = notes > 0 ? std::to_string(notes) : "";
+	std::printf("%s,%s,%s,%g,%d,%s,%.2f,%.0f\n", module, variant.c_str(), param, value, channels, notesColumn.c_str(), ns, 1e9 / ns);
+	std::fflush(stdout);
+}
+
+static void benchVariableShapeOscillator() {
+	const char* shapes[] = {"trisaw", "square"};
+	for (int shape = 0; shape < 2; shape++) {
+		for (float freq : {110.f, 1760.f, 7040.f}) {
+			for (int channels : CHANNEL_COUNTS) {
+				VariableShapeOscillator osc[MAX_CHANNELS];
+				for (int c = 0; c < channels; c++) {
+					osc[c].Init(SAMPLE_RATE);
+					osc[c].SetWaveshape(shape);
+				}
+				Signal pw(.5f, .4f);
+				float acc = 0.f;
+				double ns = timePerFrame([&](long i) {
+					const float* p = pw.at(i);
+					for (int c = 0; c < channels; c++) {
+						osc[c].SetFreq(freq);
+						osc[c].SetPW(p[c]);
+						acc += osc[c].Process();
+					}
+				}, benchFrames);
+				consume(acc);
+				report("VariableShapeOscillator", shapes[shape], "freq", freq, channels, ns);
+			}
+		}
+	}
+
+	for (int shape = 0; shape < 2; shape++) {
+		for (float freq : {110.f, 1760.f, 7040.f}) {
+			for (int channels : CHANNEL_COUNTS) {
+				VariableShapeOscillatorBank bank[MAX_CHANNELS / 4];
+				for (int b = 0; b < MAX_CHANNELS / 4; b++) {
+					bank[b].Init(SAMPLE_RATE);
+					bank[b].SetWaveshape(float_4(shape));
+				}
+				Signal pw(.5f, .4f);
+				float_4 acc = 0.f;
+				double ns = timePerFrame([&](long i) {
+					const float* p = pw.at(i);
+					for (int c = 0; c < channels; c += 4) {
+						bank[c / 4].SetFreq(float_4(freq));
+						bank[c / 4].SetPW(float_4::load(p + c));
+						acc += bank[c / 4].Process();
+					}
+				}, benchFrames);
+				consume(acc[0]);
+				report("VariableShapeOscillatorBank", shapes[shape], "freq", freq, channels, ns);
+			}
+		}
+	}
+}
+
+/** The banks with their shape fixed at compile time, as VarTriSaw uses
+ *  them, same sweep as above.
+ */
+template <typename Bank>
+static void benchFixedShapeOscillatorBank(const char* variant) {
+	for (float freq : {110.f, 1760.f, 7040.f}) {
+		for (int channels : CHANNEL_COUNTS) {
+			Bank bank[MAX_CHANNELS / 4];
+			for (int b = 0; b < MAX_CHANNELS / 4; b++) {
+				bank[b].Init(SAMPLE_RATE);
+			}
+			Signal pw(.5f, .4f);
+			float_4 acc = 0.f;
+			double ns = timePerFrame([&](long i) {
+				const float* p = pw.at(i);
+				for (int c = 0; c < channels; c += 4) {
+					bank[c / 4].SetFreq(float_4(freq));
+					bank[c / 4].SetPW(float_4::load(p + c));
+					acc += bank[c / 4].Process();
+				}
+			}, benchFrames);
+			consume(acc[0]);
+			report("VariableShapeOscillatorBank", variant, "freq", freq, channels, ns);
+		}
+	}
+}
+
+/** The wavetable engine's oscillator, same sweep as the BLEP bank above.
+ */
+static void benchWavetableOscillator() {
+	const char* shapes[] = {"trisaw", "square"};
+	for (int shape = 0; shape < 2; shape++) {
+		for (float freq : {110.f, 1760.f, 7040.f}) {
+			for (int channels : CHANNEL_COUNTS) {
+				WavetableOscillatorBank bank[MAX_CHANNELS / 4];
+				for (int b = 0; b < MAX_CHANNELS / 4; b++) {
+					bank[b].Init(SAMPLE_RATE);
+					bank[b].SetWaveshape(float_4(shape));
+				}
+				Signal pw(.5f, .4f);
+				float_4 acc = 0.f;
+				double ns = timePerFrame([&](long i) {
+					const float* p = pw.at(i);
+					for (int c = 0; c < channels; c += 4) {
+						bank[c / 4].SetFreq(float_4(freq));
+						bank[c / 4].SetPW(float_4::load(p + c));
+						acc += bank[c / 4].Process();
+					}
+				}, benchFrames);
+				consume(acc[0]);
+				report("WavetableOscillatorBank", shapes[shape], "freq", freq, channels, ns);
+			}
+		}
+	}
+}
+
+// block size for the ProcessBlock() variants
+static const int BLOCK_SIZE = 32;
+
+/** Both oscillator forms driven through ProcessBlock(), with pulse width
+ *  updated once per block instead of per sample.
+ */
+static void benchVariableShapeOscillatorBlock() {
+	const char* shapes[] = {"trisaw-block", "square-block"};
+	for (int shape = 0; shape < 2; shape++) {
+		for (float freq : {110.f, 1760.f, 7040.f}) {
+			for (int channels : CHANNEL_COUNTS) {
+				VariableShapeOscillator osc[MAX_CHANNELS];
+				for (int c = 0; c < channels; c++) {
+					osc[c].Init(SAMPLE_RATE);
+					osc[c].SetWaveshape(shape);
+				}
+				Signal pw(.5f, .4f);
+				float out[BLOCK_SIZE];
+				float acc = 0.f;
+				double ns = timePerFrame([&](long i) {
+					const float* p = pw.at(i);
+					for (int c = 0; c < channels; c++) {
+						osc[c].ProcessBlock(freq / SAMPLE_RATE, p[c], out, BLOCK_SIZE);
+						acc += out[0];
+					}
+				}, benchFrames / BLOCK_SIZE) / BLOCK_SIZE;
+				consume(acc);
+				report("VariableShapeOscillator", shapes[shape], "freq", freq, channels, ns);
+			}
+		}
+	}
+
+	for (int shape = 0; shape < 2; shape++) {
+		for (float freq : {110.f, 1760.f, 7040.f}) {
+			for (int channels : CHANNEL_COUNTS) {
+				VariableShapeOscillatorBank bank[MAX_CHANNELS / 4];
+				for (int b = 0; b < MAX_CHANNELS / 4; b++) {
+					bank[b].Init(SAMPLE_RATE);
+					bank[b].SetWaveshape(float_4(shape));
+				}
+				Signal pw(.5f, .4f);
+				float_4 out[BLOCK_SIZE];
+				float_4 acc = 0.f;
+				double ns = timePerFrame([&](long i) {
+					const float* p = pw.at(i);
+					for (int c = 0; c < channels; c += 4) {
+						bank[c / 4].ProcessBlock(float_4(freq / SAMPLE_RATE), float_4::load(p + c), out, BLOCK_SIZE);
+						acc += out[0];
+					}
+				}, benchFrames / BLOCK_SIZE) / BLOCK_SIZE;
+				consume(acc[0]);
+				report("VariableShapeOscillatorBank", shapes[shape], "freq", freq, channels, ns);
+			}
+		}
+	}
+}
+
+static void benchSoftclip() {
+	struct Variant {
+		const char* name;
+		int saturationMode;
+		int oversampling;
+		int adaa;
+	};
+	const Variant variants[] = {
+		{"exact", SoftclipCore::EXACT_SATURATION, 0, 0},
+		{"fast", SoftclipCore::FAST_SATURATION, 0, 0},
+		{"exact-os2x", SoftclipCore::EXACT_SATURATION, 1, 0},
+		{"exact-os4x", SoftclipCore::EXACT_SATURATION, 2, 0},
+		{"exact-os8x", SoftclipCore::EXACT_SATURATION, 3, 0},
+		{"fast-os2x", SoftclipCore::FAST_SATURATION, 1, 0},
+		{"fast-os4x", SoftclipCore::FAST_SATURATION, 2, 0},
+		{"fast-os8x", SoftclipCore::FAST_SATURATION, 3, 0},
+		{"adaa1", SoftclipCore::EXACT_SATURATION, 0, 1},
+		{"adaa2", SoftclipCore::EXACT_SATURATION, 0, 2},
+	};
+	for (const Variant& v : variants) {
+		for (float hardness : {0.f, .5f, .99f}) {
+			for (int channels : CHANNEL_COUNTS) {
+				SoftclipCore core;
+				core.setSaturationMode(v.saturationMode);
+				core.setOversampling(v.oversampling);
+				core.setAdaa(v.adaa);
+				Signal in(0.f, 5.f, 37.f);
+				Frame out;
+				double ns = timePerFrame([&](long i) {
+					float mix = core.process(in.at(i), out.voltages, channels, 2.f, hardness);
+					consume(mix + out.voltages[0]);
+				}, benchFrames);
+				report("Softclip", v.name, "hardness", hardness, channels, ns);
+			}
+		}
+	}
+}
+
+static void benchMoggle() {
+	for (int snapshots : {0, 16}) {
+		for (int divider : {1, 16}) {
+			for (float depth : {0.f, 5.f}) {
+				for (int channels : CHANNEL_COUNTS) {
+					MoggleCore core;
+					core.setDivider(divider);
+					// points alternating between -5 V and 5 V on every channel
+					MoggleSnapshots* stored = new MoggleSnapshots;
+					for (int s = 0; s < snapshots; s++) {
+						float values[MAX_CHANNELS];
+						std::fill(values, values + MAX_CHANNELS, s % 2 ? 5.f : -5.f);
+						stored->add(values);
+					}
+					core.snapshots.publish(stored);
+					Signal morph(5.f, depth);
+					Frame out;
+					double ns = timePerFrame([&](long i) {
+						core.process(-3.f, 7.f, morph.at(i), channels, out.voltages);
+						consume(out.voltages[0]);
+					}, benchFrames);
+					std::string variant = depth > 0.f ? "modulated" : "steady";
+					if (divider > 1)
+						variant += "-divider" + std::to_string(divider);
+					if (snapshots > 0)
+						variant += "-snapshots" + std::to_string(snapshots);
+					report("Moggle", variant, "morph_depth", depth, channels, ns);
+				}
+			}
+		}
+	}
+}
+
+static void benchPolyfotz() {
+	struct Variant {
+		const char* name;
+		float pitchwheelDepth;
+		float voicingDepth;
+	};
+	// pitchwheel below 0 V selects the voicing path
+	const Variant variants[] = {
+		{"steady", 0.f, 0.f},
+		{"pitchwheel", 2.f, 0.f},
+		{"voicing-cv", 0.f, 5.f},
+	};
+	for (const Variant& v : variants) {
+		for (float pitchwheel : {-5.f, 2.f}) {
+			// input notes, more than one is the polyphonic input mode
+			for (int notes : {1, 2, 4}) {
+				PolyfotzCore core;
+				Signal cv(0.f, 1.f);
+				Signal pw(pitchwheel, v.pitchwheelDepth, 5.f);
+				Signal voicing(5.f, v.voicingDepth, 3.f);
+				Frame poly, aft, gain;
+				int channels = 0;
+				double ns = timePerFrame([&](long i) {
+					PolyfotzCore::Controls controls;
+					controls.notes = notes;
+					for (int n = 0; n < notes; n++) {
+						controls.cv[n] = cv.at(i)[n];
+					}
+					controls.pitchwheelIn = pw.at(i)[0];
+					controls.voicingIn = voicing.at(i)[0];
+					controls.voicingCv = v.voicingDepth > 0.f;
+					channels = std::max(channels, core.process(controls, poly.voltages, aft.voltages, gain.voltages));
+					consume(poly.voltages[0] + aft.voltages[0]);
+				}, benchFrames);
+				report("Polyfotz", v.name, "pitchwheel", pitchwheel, channels, ns, notes);
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	int cpuLevel = CpuDispatch::detect();
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--frames" && i + 1 < argc) {
+			benchFrames = std::atol(argv[++i]);
+		}
+		else if (arg == "--only" && i + 1 < argc) {
+			only = argv[++i];
+		}
+		else if (arg == "--cpu" && i + 1 < argc && CpuDispatch::parse(argv[i + 1]) >= 0) {
+			cpuLevel = CpuDispatch::parse(argv[++i]);
+		}
+		else {
+			std::fprintf(stderr, "usage: %s [--frames N] [--only MODULE] [--cpu baseline|avx2]\n", argv[0]);
+			return 1;
+		}
+	}
+	cpuLevel = CpuDispatch::select(cpuLevel);
+	std::fprintf(stderr, "kernels: %s\n", CpuDispatch::name(cpuLevel));
+
+	std::printf("module,variant,param,value,channels,notes,ns_per_sample,samples_per_sec\n");
+	if (selected("VariableShapeOscillator")) {
+		benchVariableShapeOscillator();
+		benchFixedShapeOscillatorBank<TriSawOscillatorBank>("trisaw-fixed");
+		benchFixedShapeOscillatorBank<SquareOscillatorBank>("square-fixed");
+		benchVariableShapeOscillatorBlock();
+	}
+	if (selected("WavetableOscillator"))
+		benchWavetableOscillator();
+	if (selected("VarTriSaw"))
+		benchVarTriSaw();
+	if (selected("Softclip"))
+		benchSoftclip();
+	if (selected("Moggle"))
+		benchMoggle();
+	if (selected("Polyfotz"))
+		benchPolyfotz();
+	return 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include "harness.hpp"
+
+/** Shared by the benchmark translation units, see bench.cpp.
+ */
+
+// frames per timed run
+extern long benchFrames;
+static const int CHANNEL_COUNTS[] = {1, 4, 8, 16};
+
+// notes is the number of notes played into Polyfotz, 0 for rows without it
+void report(const char* module, const std::string& variant, const char* param, float value, int channels, double ns, int notes = 0);
+
+void benchVarTriSaw();
@@ -0,0 +1,130 @@
+/** VarTriSaw's benchmarks, in their own translation unit like the module
+ * itself, so the inliner budgets its oscillators the way the plugin build
+ * does rather than sharing one unit with every other core.
+ */
+#include "bench.hpp"
+#include "vartrisawcore.h"
+#include "polyfotzcore.h"
+
+using namespace harness;
+
+static double timeVarTriSaw(int engine, float voct, int channels, int unison = 1) {
+	VarTriSawCore core;
+	core.init(SAMPLE_RATE);
+	core.setEngine(engine);
+	core.setUnison(unison, .1f, .05f);
+	Signal pitch(voct, 1.f / 12.f);
+	Signal aft(5.f, 5.f, 3.f);
+	Signal gain(5.f, 5.f, 2.f);
+	Frame saw, sqr;
+	return timePerFrame([&](long i) {
+		VarTriSawCore::PolyInput voctIn = {pitch.at(i), channels};
+		VarTriSawCore::PolyInput aftIn = {aft.at(i), channels};
+		VarTriSawCore::PolyInput gainIn = {gain.at(i), channels};
+		core.process(voctIn, aftIn, gainIn, 1.f, saw.voltages, sqr.voltages);
+		consume(saw.voltages[0] + sqr.voltages[0]);
+	}, benchFrames);
+}
+
+void benchVarTriSaw() {
+	const char* engines[] = {"blep", "wavetable"};
+	for (int engine = 0; engine < VarTriSawCore::ENGINES_LEN; engine++) {
+		for (float voct : {-2.f, 0.f, 3.f}) {
+			for (int channels : CHANNEL_COUNTS) {
+				report("VarTriSaw", engines[engine], "voct", voct, channels, timeVarTriSaw(engine, voct, channels));
+			}
+		}
+	}
+
+	// both engines at every voice count, the wavetable engine wins from
+	// the first count where wavetable_ns_per_voice < blep_ns_per_voice
+	for (int channels = 1; channels <= MAX_CHANNELS; channels++) {
+		for (int engine = 0; engine < VarTriSawCore::ENGINES_LEN; engine++) {
+			report("VarTriSaw", std::string(engines[engine]) + "-crossover", "voct", 0.f, channels, timeVarTriSaw(engine, 0.f, channels));
+		}
+	}
+
+	// unison stacks, compare ns_per_sample / (channels * unison) to unison1
+	for (int unison : {1, 2, 4, 8}) {
+		for (int engine = 0; engine < VarTriSawCore::ENGINES_LEN; engine++) {
+			for (int channels : CHANNEL_COUNTS) {
+				report("VarTriSaw", std::string(engines[engine]) + "-unison" + std::to_string(unison), "voct", 0.f, channels, timeVarTriSaw(engine, 0.f, channels, unison));
+			}
+		}
+	}
+
+	// 16 voices with only the first few gated on, with and without culling
+	for (float hold : {0.f, .05f}) {
+		for (int active : {0, 4, 8, 16}) {
+			VarTriSawCore core;
+			core.init(SAMPLE_RATE);
+			core.setCullHoldTime(hold);
+			Signal pitch(0.f, 1.f / 12.f);
+			Signal aft(5.f, 5.f, 3.f);
+			Signal gain;
+			for (int i = 0; i < SIGNAL_LEN; i++) {
+				for (int c = 0; c < active; c++) {
+					gain.frames[i * MAX_CHANNELS + c] = 8.f;
+				}
+			}
+			Frame saw, sqr;
+			double ns = timePerFrame([&](long i) {
+				VarTriSawCore::PolyInput voctIn = {pitch.at(i), MAX_CHANNELS};
+				VarTriSawCore::PolyInput aftIn = {aft.at(i), MAX_CHANNELS};
+				VarTriSawCore::PolyInput gainIn = {gain.at(i), MAX_CHANNELS};
+				core.process(voctIn, aftIn, gainIn, 1.f, saw.voltages, sqr.voltages);
+				consume(saw.voltages[0] + sqr.voltages[0]);
+			}, benchFrames);
+			report("VarTriSaw", hold > 0.f ? "culling" : "no-culling", "active_voices", active, MAX_CHANNELS, ns);
+		}
+	}
+
+	// Polyfotz into VarTriSaw, patched with cables or side by side on the
+	// expander bus, both cores timed together. Up to 4 notes of 4 voices
+	// fit the cables, the bus also takes 4 notes of a 16 voice voicing.
+	for (int voicingSize : {4, 16}) {
+		for (int bus = 0; bus < 2; bus++) {
+			if (voicingSize > 4 && !bus)
+				continue;
+			for (int notes = 1; notes <= PolyfotzCore::MAX_NOTES; notes++) {
+				PolyfotzCore polyfotz;
+				polyfotz.setSampleRate(SAMPLE_RATE);
+				VoicingBank* bank = new VoicingBank;
+				bank->clear();
+				int voices[VoicingBank::MAX_VOICES];
+				for (int v = 0; v < voicingSize; v++) {
+					voices[v] = -v;
+				}
+				bank->add(voices, voicingSize);
+				polyfotz.voicings.publish(bank);
+				VarTriSawCore core;
+				core.init(SAMPLE_RATE);
+				Signal cv(0.f, 1.f / 12.f);
+				VoiceBusMessage message;
+				Frame poly, aft, gain, saw, sqr;
+				double ns = timePerFrame([&](long i) {
+					PolyfotzCore::Controls controls;
+					controls.notes = notes;
+					for (int n = 0; n < notes; n++) {
+						controls.cv[n] = cv.at(i)[n];
+					}
+					// below 0 V the pitchwheel plays the voicing
+					controls.pitchwheelIn = -5.f;
+					int channels = polyfotz.process(controls, poly.voltages, aft.voltages, gain.voltages);
+					if (bus) {
+						polyfotz.processBus(&message);
+						core.processBus(message, 1.f, saw.voltages, sqr.voltages);
+					}
+					else {
+						VarTriSawCore::PolyInput voctIn = {poly.voltages, channels};
+						VarTriSawCore::PolyInput aftIn = {aft.voltages, channels};
+						VarTriSawCore::PolyInput gainIn = {gain.voltages, channels};
+						core.process(voctIn, aftIn, gainIn, 1.f, saw.voltages, sqr.voltages);
+					}
+					consume(saw.voltages[0] + sqr.voltages[0]);
+				}, benchFrames);
+				report("VarTriSaw", bus ? "polyfotz-bus" : "polyfotz-cables", "notes", notes, notes * voicingSize, ns, notes);
+			}
+		}
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/** Minimal stand-in for the Rack engine used by the headless tools: a
+ *  fixed sample rate, per channel control signals and a timer. The DSP
+ *  cores in src/ only see plain float buffers, so this is all they need.
+ */
+namespace harness {
+
+static const float SAMPLE_RATE = 48000.f;
+static const int MAX_CHANNELS = 16;
+// length of the precomputed control signals, a power of two
+static const int SIGNAL_LEN = 4096;
+
+/** A polyphonic control signal, one precomputed sine LFO per channel so
+ *  the cores never see constant inputs unless asked to.
+ */
+struct Signal {
+	std::vector<float> frames;
+
+	Signal(float offset = 0.f, float depth = 0.f, float rate = 1.f) {
+		frames.resize(SIGNAL_LEN * MAX_CHANNELS);
+		for (int i = 0; i < SIGNAL_LEN; i++) {
+			for (int c = 0; c < MAX_CHANNELS; c++) {
+				float phase = 2.f * M_PI * (rate * i / SIGNAL_LEN + c / (float)MAX_CHANNELS);
+				frames[i * MAX_CHANNELS + c] = offset + depth * std::sin(phase);
+			}
+		}
+	}
+
+	/** The voltages of all channels at frame i.
+	 */
+	const float* at(long i) const {
+		return &frames[(i & (SIGNAL_LEN - 1)) * MAX_CHANNELS];
+	}
+};
+
+/** Output buffer for one frame, padded so cores can store groups of four.
+ */
+struct Frame {
+	alignas(16) float voltages[MAX_CHANNELS];
+
+	Frame() {
+		std::memset(voltages, 0, sizeof(voltages));
+	}
+};
+
+/** Keeps the optimizer from dropping work whose results are never used.
+ */
+inline void consume(float x) {
+	static volatile float sink;
+	sink = x;
+	(void) sink;
+}
+
+/** Runs f(frame) for frames frames, repeats times, returns the median
+ *  nanoseconds per frame.
+ */
+template <typename F>
+double timePerFrame(F f, long frames, int repeats = 5) {
+	std::vector<double> times;
+	// warm up caches and branch predictors
+	for (long i = 0; i < frames / 8; i++) {
+		f(i);
+	}
+	for (int r = 0; r < repeats; r++) {
+		auto start = std::chrono::steady_clock::now();
+		for (long i = 0; i < frames; i++) {
+			f(i);
+		}
+		auto end = std::chrono::steady_clock::now();
+		times.push_back(std::chrono::duration<double, std::nano>(end - start).count() / frames);
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+} // namespace harness
@@ -0,0 +1,1221 @@
+#include <cctype>
+#include <cstdarg>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <osdialog.h>
+#include "headless.hpp"
+
+/** The implementation behind tools/headless/include, the parts of Rack's
+ *  library the plugin calls, and the headless:: API the tools drive it with.
+ */
+
+// the plugin's entry point, plugin.cpp
+void init(rack::plugin::Plugin* p);
+
+namespace rack {
+
+namespace logger {
+
+void log(Level level, const char* filename, int line, const char* func, const char* format, ...) {
+	static const char* const LEVEL_NAMES[] = {"debug", "info", "warn", "fatal"};
+	std::fprintf(stderr, "[%s %s:%d %s] ", LEVEL_NAMES[level], system::getFilename(filename).c_str(), line, func);
+	va_list args;
+	va_start(args, format);
+	std::vfprintf(stderr, format, args);
+	va_end(args);
+	std::fputc('\n', stderr);
+}
+
+} // namespace logger
+
+namespace string {
+
+std::string f(const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	va_list argsCopy;
+	va_copy(argsCopy, args);
+	int size = std::vsnprintf(NULL, 0, format, args);
+	va_end(args);
+	std::string s(size > 0 ? size : 0, '\0');
+	std::vsnprintf(&s[0], s.size() + 1, format, argsCopy);
+	va_end(argsCopy);
+	return s;
+}
+
+} // namespace string
+
+namespace system {
+
+std::string getFilename(const std::string& path) {
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+} // namespace system
+
+namespace asset {
+
+std::string plugin(plugin::Plugin* plugin, const std::string& filename) {
+	return plugin->path + "/" + filename;
+}
+
+std::string user(const std::string& filename) {
+	return "build/headless-user/" + filename;
+}
+
+} // namespace asset
+
+namespace engine {
+
+Param* ParamQuantity::getParam() {
+	return module ? &module->params[paramId] : NULL;
+}
+
+void ParamQuantity::setValue(float value) {
+	if (!module)
+		return;
+	value = math::clamp(value, getMinValue(), getMaxValue());
+	if (snapEnabled)
+		value = std::round(value);
+	getParam()->setValue(value);
+}
+
+float ParamQuantity::getValue() {
+	return module ? getParam()->getValue() : getDefaultValue();
+}
+
+float ParamQuantity::getDisplayValue() {
+	float v = getValue();
+	if (displayBase < 0.f)
+		v = std::log(v) / std::log(-displayBase);
+	else if (displayBase > 0.f)
+		v = std::pow(displayBase, v);
+	return v * displayMultiplier + displayOffset;
+}
+
+std::string ParamQuantity::getDisplayValueString() {
+	return string::f("%.5g", getDisplayValue());
+}
+
+std::string SwitchQuantity::getDisplayValueString() {
+	int index = (int) std::floor(getValue() - getMinValue());
+	if (index < 0 || index >= (int) labels.size())
+		return ParamQuantity::getDisplayValueString();
+	return labels[index];
+}
+
+Module::~Module() {
+	for (ParamQuantity* q : paramQuantities) {
+		delete q;
+	}
+	for (PortInfo* info : inputInfos) {
+		delete info;
+	}
+	for (PortInfo* info : outputInfos) {
+		delete info;
+	}
+	for (LightInfo* info : lightInfos) {
+		delete info;
+	}
+}
+
+void Module::config(int numParams, int numInputs, int numOutputs, int numLights) {
+	params.resize(numParams);
+	inputs.resize(numInputs);
+	outputs.resize(numOutputs);
+	lights.resize(numLights);
+	paramQuantities.resize(numParams);
+	inputInfos.resize(numInputs);
+	outputInfos.resize(numOutputs);
+	lightInfos.resize(numLights);
+	// unnamed ports and params, like Rack's defaults
+	for (int i = 0; i < numParams; i++) {
+		configParam(i, 0.f, 1.f, 0.f);
+	}
+	for (int i = 0; i < numInputs; i++) {
+		configInput(i);
+	}
+	for (int i = 0; i < numOutputs; i++) {
+		configOutput(i);
+	}
+}
+
+Engine::Engine() {
+	// enough that adding modules and cables never reallocates while a
+	// tool's audio thread steps
+	modules.reserve(64);
+	cables.reserve(256);
+}
+
+Engine::~Engine() {
+	clear();
+}
+
+void Engine::addModule(Module* module) {
+	module->id = nextId++;
+	modules.push_back(module);
+	module->onAdd(Module::AddEvent());
+	updateExpanders();
+}
+
+void Engine::removeModule(Module* module) {
+	std::vector<Cable*> attached;
+	for (Cable* cable : cables) {
+		if (cable->inputModule == module || cable->outputModule == module)
+			attached.push_back(cable);
+	}
+	for (Cable* cable : attached) {
+		removeCable(cable);
+	}
+	module->onRemove(Module::RemoveEvent());
+	modules.erase(std::remove(modules.begin(), modules.end(), module), modules.end());
+	module->leftExpander.module = NULL;
+	module->leftExpander.moduleId = -1;
+	module->rightExpander.module = NULL;
+	module->rightExpander.moduleId = -1;
+	updateExpanders();
+	delete module;
+}
+
+Module* Engine::getModule(int64_t moduleId) {
+	for (Module* module : modules) {
+		if (module->id == moduleId)
+			return module;
+	}
+	return NULL;
+}
+
+std::vector<int64_t> Engine::getModuleIds() {
+	std::vector<int64_t> ids;
+	for (Module* module : modules) {
+		ids.push_back(module->id);
+	}
+	return ids;
+}
+
+void Engine::addCable(Cable* cable) {
+	cable->id = nextId++;
+	cables.push_back(cable);
+	Output& output = cable->outputModule->outputs[cable->outputId];
+	if (output.channels == 0)
+		output.channels = 1;
+}
+
+void Engine::removeCable(Cable* cable) {
+	cables.erase(std::remove(cables.begin(), cables.end(), cable), cables.end());
+	Input& input = cable->inputModule->inputs[cable->inputId];
+	input.channels = 0;
+	std::memset(input.voltages, 0, sizeof(input.voltages));
+	bool outputPatched = false;
+	for (Cable* other : cables) {
+		outputPatched |= other->outputModule == cable->outputModule && other->outputId == cable->outputId;
+	}
+	if (!outputPatched) {
+		Output& output = cable->outputModule->outputs[cable->outputId];
+		output.channels = 0;
+		std::memset(output.voltages, 0, sizeof(output.voltages));
+	}
+	delete cable;
+}
+
+void Engine::clear() {
+	while (!cables.empty()) {
+		removeCable(cables.back());
+	}
+	while (!modules.empty()) {
+		removeModule(modules.back());
+	}
+}
+
+float Engine::getSampleRate() {
+	return sampleRate;
+}
+
+float Engine::getSampleTime() {
+	return 1.f / sampleRate;
+}
+
+void Engine::setSampleRate(float sampleRate) {
+	this->sampleRate = sampleRate;
+	Module::SampleRateChangeEvent e;
+	e.sampleRate = sampleRate;
+	e.sampleTime = 1.f / sampleRate;
+	for (Module* module : modules) {
+		module->onSampleRateChange(e);
+	}
+}
+
+int64_t Engine::getFrame() {
+	return frame;
+}
+
+static void flipMessages(Module::Expander& expander) {
+	if (expander.messageFlipRequested) {
+		std::swap(expander.producerMessage, expander.consumerMessage);
+		expander.messageFlipRequested = false;
+	}
+}
+
+void Engine::stepBlock(int frames) {
+	Module::ProcessArgs args;
+	args.sampleRate = sampleRate;
+	args.sampleTime = 1.f / sampleRate;
+	for (int i = 0; i < frames; i++) {
+		args.frame = frame;
+		for (Module* module : modules) {
+			module->process(args);
+		}
+		for (Module* module : modules) {
+			flipMessages(module->leftExpander);
+			flipMessages(module->rightExpander);
+		}
+		for (Cable* cable : cables) {
+			Output& output = cable->outputModule->outputs[cable->outputId];
+			Input& input = cable->inputModule->inputs[cable->inputId];
+			input.channels = output.channels;
+			std::memcpy(input.voltages, output.voltages, sizeof(input.voltages));
+		}
+		frame++;
+	}
+}
+
+void Engine::updateExpanders() {
+	for (size_t i = 0; i < modules.size(); i++) {
+		Module* left = i > 0 ? modules[i - 1] : NULL;
+		Module* right = i + 1 < modules.size() ? modules[i + 1] : NULL;
+		Module::Expander* sides[2] = {&modules[i]->leftExpander, &modules[i]->rightExpander};
+		Module* neighbours[2] = {left, right};
+		for (uint8_t side = 0; side < 2; side++) {
+			if (sides[side]->module == neighbours[side])
+				continue;
+			sides[side]->module = neighbours[side];
+			sides[side]->moduleId = neighbours[side] ? neighbours[side]->id : -1;
+			Module::ExpanderChangeEvent e;
+			e.side = side;
+			modules[i]->onExpanderChange(e);
+		}
+	}
+}
+
+} // namespace engine
+
+namespace widget {
+
+Widget::~Widget() {
+	clearChildren();
+}
+
+void Widget::addChild(Widget* child) {
+	child->parent = this;
+	children.push_back(child);
+}
+
+void Widget::removeChild(Widget* child) {
+	children.remove(child);
+	child->parent = NULL;
+}
+
+void Widget::clearChildren() {
+	for (Widget* child : children) {
+		delete child;
+	}
+	children.clear();
+}
+
+} // namespace widget
+
+namespace app {
+
+engine::ParamQuantity* ParamWidget::getParamQuantity() {
+	return module ? module->paramQuantities[paramId] : NULL;
+}
+
+void Knob::initParamQuantity() {
+	engine::ParamQuantity* pq = getParamQuantity();
+	if (pq && snap)
+		pq->snapEnabled = true;
+}
+
+void ModuleWidget::setPanel(widget::Widget* panel) {
+	if (this->panel) {
+		removeChild(this->panel);
+		delete this->panel;
+	}
+	this->panel = panel;
+	addChild(panel);
+	box.size = math::Vec(RACK_GRID_WIDTH * 10, RACK_GRID_HEIGHT);
+}
+
+void ModuleWidget::addParam(ParamWidget* param) {
+	addChild(param);
+	params.push_back(param);
+}
+
+void ModuleWidget::addInput(PortWidget* input) {
+	addChild(input);
+	inputs.push_back(input);
+}
+
+void ModuleWidget::addOutput(PortWidget* output) {
+	addChild(output);
+	outputs.push_back(output);
+}
+
+ParamWidget* ModuleWidget::getParam(int paramId) {
+	for (ParamWidget* param : params) {
+		if (param->paramId == paramId)
+			return param;
+	}
+	return NULL;
+}
+
+} // namespace app
+
+namespace plugin {
+
+Plugin::~Plugin() {
+	for (Model* model : models) {
+		delete model;
+	}
+}
+
+void Plugin::addModel(Model* model) {
+	model->plugin = this;
+	models.push_back(model);
+}
+
+Model* Plugin::getModel(const std::string& slug) {
+	for (Model* model : models) {
+		if (model->slug == slug)
+			return model;
+	}
+	return NULL;
+}
+
+} // namespace plugin
+
+static Context* defaultContext() {
+	static engine::Engine engine;
+	static window::Window window;
+	static Context context;
+	context.engine = &engine;
+	context.window = &window;
+	return &context;
+}
+
+static thread_local Context* threadContext = NULL;
+
+Context* contextGet() {
+	if (!threadContext)
+		threadContext = defaultContext();
+	return threadContext;
+}
+
+void contextSet(Context* context) {
+	threadContext = context;
+}
+
+// menu helpers, built the way Rack's helpers.hpp builds them
+
+namespace {
+
+struct ActionMenuItem : ui::MenuItem {
+	std::function<void()> action;
+
+	void onAction(const ActionEvent& e) override {
+		action();
+	}
+};
+
+struct SubmenuItem : ui::MenuItem {
+	std::function<void(ui::Menu* menu)> createMenu;
+
+	ui::Menu* createChildMenu() override {
+		ui::Menu* menu = new ui::Menu;
+		createMenu(menu);
+		return menu;
+	}
+};
+
+} // namespace
+
+ui::MenuLabel* createMenuLabel(std::string text) {
+	ui::MenuLabel* label = new ui::MenuLabel;
+	label->text = text;
+	return label;
+}
+
+ui::MenuItem* createMenuItem(std::string text, std::string rightText, std::function<void()> action, bool disabled, bool alwaysConsume) {
+	ActionMenuItem* item = new ActionMenuItem;
+	item->text = text;
+	item->rightText = rightText;
+	item->action = action;
+	item->disabled = disabled;
+	return item;
+}
+
+ui::MenuItem* createCheckMenuItem(std::string text, std::string rightText, std::function<bool()> checked, std::function<void()> action, bool disabled, bool alwaysConsume) {
+	if (checked())
+		rightText += (rightText.empty() ? "" : "  ") + std::string(CHECKMARK_STRING);
+	return createMenuItem(text, rightText, action, disabled, alwaysConsume);
+}
+
+ui::MenuItem* createBoolMenuItem(std::string text, std::string rightText, std::function<bool()> getter, std::function<void(bool)> setter, bool disabled, bool alwaysConsume) {
+	return createCheckMenuItem(text, rightText, getter, [=]() {setter(!getter());}, disabled, alwaysConsume);
+}
+
+ui::MenuItem* createSubmenuItem(std::string text, std::string rightText, std::function<void(ui::Menu* menu)> createMenu, bool disabled) {
+	SubmenuItem* item = new SubmenuItem;
+	item->text = text;
+	item->rightText = rightText + (rightText.empty() ? "" : "  ") + RIGHT_ARROW;
+	item->createMenu = createMenu;
+	item->disabled = disabled;
+	return item;
+}
+
+ui::MenuItem* createIndexSubmenuItem(std::string text, std::vector<std::string> labels, std::function<size_t()> getter, std::function<void(size_t val)> setter, bool disabled, bool alwaysConsume) {
+	size_t index = getter();
+	std::string label = index < labels.size() ? labels[index] : "";
+	return createSubmenuItem(text, label, [=](ui::Menu* menu) {
+		for (size_t i = 0; i < labels.size(); i++) {
+			menu->addChild(createCheckMenuItem(labels[i], "",
+				[=]() {return getter() == i;},
+				[=]() {setter(i);},
+				false, alwaysConsume
+			));
+		}
+	}, disabled);
+}
+
+} // namespace rack
+
+// GLFW and osdialog without a desktop
+
+static std::string clipboardText;
+static std::string fileDialogAnswer;
+static bool fileDialogAnswered = false;
+
+void glfwSetClipboardString(GLFWwindow* window, const char* string) {
+	clipboardText = string;
+}
+
+int osdialog_message(osdialog_message_level level, osdialog_message_buttons buttons, const char* message) {
+	std::fprintf(stderr, "[dialog] %s\n", message);
+	return 1;
+}
+
+char* osdialog_file(osdialog_file_action action, const char* dir, const char* filename, const osdialog_filters* filters) {
+	if (!fileDialogAnswered)
+		return NULL;
+	fileDialogAnswered = false;
+	return strdup(fileDialogAnswer.c_str());
+}
+
+osdialog_filters* osdialog_filters_parse(const char* str) {
+	return NULL;
+}
+
+void osdialog_filters_free(osdialog_filters* filters) {}
+
+// jansson
+
+namespace {
+
+// the singletons are never freed, like in jansson
+const size_t STATIC_REFCOUNT = (size_t) -1;
+
+struct JsonObject : json_t {
+	std::vector<std::pair<std::string, json_t*>> items;
+};
+
+struct JsonArray : json_t {
+	std::vector<json_t*> items;
+};
+
+struct JsonString : json_t {
+	std::string value;
+};
+
+struct JsonInteger : json_t {
+	json_int_t value;
+};
+
+struct JsonReal : json_t {
+	double value;
+};
+
+template <class T>
+T* newJson(json_type type) {
+	T* json = new T;
+	json->type = type;
+	json->refcount = 1;
+	return json;
+}
+
+json_t* staticJson(json_type type) {
+	json_t* json = new json_t;
+	json->type = type;
+	json->refcount = STATIC_REFCOUNT;
+	return json;
+}
+
+} // namespace
+
+json_t* json_object() {
+	return newJson<JsonObject>(JSON_OBJECT);
+}
+
+json_t* json_array() {
+	return newJson<JsonArray>(JSON_ARRAY);
+}
+
+json_t* json_string(const char* value) {
+	if (!value)
+		return NULL;
+	JsonString* json = newJson<JsonString>(JSON_STRING);
+	json->value = value;
+	return json;
+}
+
+json_t* json_integer(json_int_t value) {
+	JsonInteger* json = newJson<JsonInteger>(JSON_INTEGER);
+	json->value = value;
+	return json;
+}
+
+json_t* json_real(double value) {
+	JsonReal* json = newJson<JsonReal>(JSON_REAL);
+	json->value = value;
+	return json;
+}
+
+json_t* json_true() {
+	static json_t* json = staticJson(JSON_TRUE);
+	return json;
+}
+
+json_t* json_false() {
+	static json_t* json = staticJson(JSON_FALSE);
+	return json;
+}
+
+json_t* json_null() {
+	static json_t* json = staticJson(JSON_NULL);
+	return json;
+}
+
+json_t* json_incref(json_t* json) {
+	if (json && json->refcount != STATIC_REFCOUNT)
+		json->refcount++;
+	return json;
+}
+
+void json_decref(json_t* json) {
+	if (!json || json->refcount == STATIC_REFCOUNT || --json->refcount > 0)
+		return;
+	switch (json->type) {
+		case JSON_OBJECT: {
+			JsonObject* object = static_cast<JsonObject*>(json);
+			for (auto& item : object->items) {
+				json_decref(item.second);
+			}
+			delete object;
+		} break;
+		case JSON_ARRAY: {
+			JsonArray* array = static_cast<JsonArray*>(json);
+			for (json_t* item : array->items) {
+				json_decref(item);
+			}
+			delete array;
+		} break;
+		case JSON_STRING: delete static_cast<JsonString*>(json); break;
+		case JSON_INTEGER: delete static_cast<JsonInteger*>(json); break;
+		case JSON_REAL: delete static_cast<JsonReal*>(json); break;
+		default: break;
+	}
+}
+
+json_t* json_deep_copy(const json_t* json) {
+	if (!json)
+		return NULL;
+	switch (json->type) {
+		case JSON_OBJECT: {
+			json_t* copy = json_object();
+			for (auto& item : static_cast<const JsonObject*>(json)->items) {
+				json_object_set_new(copy, item.first.c_str(), json_deep_copy(item.second));
+			}
+			return copy;
+		}
+		case JSON_ARRAY: {
+			json_t* copy = json_array();
+			for (json_t* item : static_cast<const JsonArray*>(json)->items) {
+				json_array_append_new(copy, json_deep_copy(item));
+			}
+			return copy;
+		}
+		case JSON_STRING: return json_string(json_string_value(json));
+		case JSON_INTEGER: return json_integer(json_integer_value(json));
+		case JSON_REAL: return json_real(json_real_value(json));
+		default: return (json_t*) json;
+	}
+}
+
+size_t json_object_size(const json_t* object) {
+	return json_is_object(object) ? static_cast<const JsonObject*>(object)->items.size() : 0;
+}
+
+json_t* json_object_get(const json_t* object, const char* key) {
+	if (!json_is_object(object))
+		return NULL;
+	for (auto& item : static_cast<const JsonObject*>(object)->items) {
+		if (item.first == key)
+			return item.second;
+	}
+	return NULL;
+}
+
+int json_object_set_new(json_t* object, const char* key, json_t* value) {
+	if (!value)
+		return -1;
+	if (!json_is_object(object)) {
+		json_decref(value);
+		return -1;
+	}
+	for (auto& item : static_cast<JsonObject*>(object)->items) {
+		if (item.first == key) {
+			json_decref(item.second);
+			item.second = value;
+			return 0;
+		}
+	}
+	static_cast<JsonObject*>(object)->items.emplace_back(key, value);
+	return 0;
+}
+
+int json_object_set(json_t* object, const char* key, json_t* value) {
+	return json_object_set_new(object, key, json_incref(value));
+}
+
+int json_object_del(json_t* object, const char* key) {
+	if (!json_is_object(object))
+		return -1;
+	auto& items = static_cast<JsonObject*>(object)->items;
+	for (auto it = items.begin(); it != items.end(); ++it) {
+		if (it->first == key) {
+			json_decref(it->second);
+			items.erase(it);
+			return 0;
+		}
+	}
+	return -1;
+}
+
+int json_object_update(json_t* object, json_t* other) {
+	if (!json_is_object(object) || !json_is_object(other))
+		return -1;
+	for (auto& item : static_cast<JsonObject*>(other)->items) {
+		json_object_set(object, item.first.c_str(), item.second);
+	}
+	return 0;
+}
+
+size_t json_array_size(const json_t* array) {
+	return json_is_array(array) ? static_cast<const JsonArray*>(array)->items.size() : 0;
+}
+
+json_t* json_array_get(const json_t* array, size_t index) {
+	if (index >= json_array_size(array))
+		return NULL;
+	return static_cast<const JsonArray*>(array)->items[index];
+}
+
+int json_array_append_new(json_t* array, json_t* value) {
+	if (!value)
+		return -1;
+	if (!json_is_array(array)) {
+		json_decref(value);
+		return -1;
+	}
+	static_cast<JsonArray*>(array)->items.push_back(value);
+	return 0;
+}
+
+int json_array_append(json_t* array, json_t* value) {
+	return json_array_append_new(array, json_incref(value));
+}
+
+const char* json_string_value(const json_t* string) {
+	return json_is_string(string) ? static_cast<const JsonString*>(string)->value.c_str() : NULL;
+}
+
+json_int_t json_integer_value(const json_t* integer) {
+	return json_is_integer(integer) ? static_cast<const JsonInteger*>(integer)->value : 0;
+}
+
+double json_real_value(const json_t* real) {
+	return json_is_real(real) ? static_cast<const JsonReal*>(real)->value : 0.0;
+}
+
+double json_number_value(const json_t* json) {
+	return json_is_integer(json) ? (double) json_integer_value(json) : json_real_value(json);
+}
+
+static void dumpString(const std::string& s, std::string& out) {
+	out += '"';
+	for (unsigned char c : s) {
+		switch (c) {
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if (c < 0x20)
+					out += rack::string::f("\\u%04x", c);
+				else
+					out += (char) c;
+		}
+	}
+	out += '"';
+}
+
+static void dump(const json_t* json, size_t flags, int depth, std::string& out) {
+	int indent = flags & 0x1f;
+	bool compact = flags & JSON_COMPACT;
+	std::string newline = indent > 0 ? "\n" + std::string((depth + 1) * indent, ' ') : "";
+	std::string closing = indent > 0 ? "\n" + std::string(depth * indent, ' ') : "";
+	std::string comma = indent > 0 || compact ? "," : ", ";
+	switch (json->type) {
+		case JSON_OBJECT: {
+			auto& items = static_cast<const JsonObject*>(json)->items;
+			out += '{';
+			for (size_t i = 0; i < items.size(); i++) {
+				out += (i > 0 ? comma : "") + newline;
+				dumpString(items[i].first, out);
+				out += compact ? ":" : ": ";
+				dump(items[i].second, flags, depth + 1, out);
+			}
+			out += (items.empty() ? "" : closing) + "}";
+		} break;
+		case JSON_ARRAY: {
+			auto& items = static_cast<const JsonArray*>(json)->items;
+			out += '[';
+			for (size_t i = 0; i < items.size(); i++) {
+				out += (i > 0 ? comma : "") + newline;
+				dump(items[i], flags, depth + 1, out);
+			}
+			out += (items.empty() ? "" : closing) + "]";
+		} break;
+		case JSON_STRING: dumpString(json_string_value(json), out); break;
+		case JSON_INTEGER: out += rack::string::f("%lld", json_integer_value(json)); break;
+		case JSON_REAL: {
+			std::string real = rack::string::f("%.17g", json_real_value(json));
+			// keep it a real when read back
+			if (real.find_first_of(".eE") == std::string::npos)
+				real += ".0";
+			out += real;
+		} break;
+		case JSON_TRUE: out += "true"; break;
+		case JSON_FALSE: out += "false"; break;
+		case JSON_NULL: out += "null"; break;
+	}
+}
+
+char* json_dumps(const json_t* json, size_t flags) {
+	if (!json)
+		return NULL;
+	std::string out;
+	dump(json, flags, 0, out);
+	return strdup(out.c_str());
+}
+
+namespace {
+
+/** Recursive descent over the JSON grammar, failing on the first error.
+ */
+struct JsonParser {
+	const char* p;
+	const char* start;
+	std::string error;
+
+	void skipSpace() {
+		while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+			p++;
+		}
+	}
+
+	json_t* fail(const std::string& message) {
+		if (error.empty())
+			error = message;
+		return NULL;
+	}
+
+	bool literal(const char* word) {
+		size_t size = std::strlen(word);
+		if (std::strncmp(p, word, size) != 0)
+			return false;
+		p += size;
+		return true;
+	}
+
+	bool parseString(std::string& s) {
+		// past the opening quote
+		p++;
+		while (*p != '"') {
+			if (*p == '\0' || (unsigned char) *p < 0x20)
+				return false;
+			if (*p != '\\') {
+				s += *p++;
+				continue;
+			}
+			p++;
+			switch (*p++) {
+				case '"': s += '"'; break;
+				case '\\': s += '\\'; break;
+				case '/': s += '/'; break;
+				case 'b': s += '\b'; break;
+				case 'f': s += '\f'; break;
+				case 'n': s += '\n'; break;
+				case 'r': s += '\r'; break;
+				case 't': s += '\t'; break;
+				case 'u': {
+					unsigned code = 0;
+					for (int i = 0; i < 4; i++, p++) {
+						char c = *p;
+						if (!std::isxdigit((unsigned char) c))
+							return false;
+						code = code * 16 + (std::isdigit((unsigned char) c) ? c - '0' : (c | 0x20) - 'a' + 10);
+					}
+					// UTF-8, the basic plane is enough here
+					if (code < 0x80) {
+						s += (char) code;
+					}
+					else if (code < 0x800) {
+						s += (char) (0xc0 | code >> 6);
+						s += (char) (0x80 | (code & 0x3f));
+					}
+					else {
+						s += (char) (0xe0 | code >> 12);
+						s += (char) (0x80 | ((code >> 6) & 0x3f));
+						s += (char) (0x80 | (code & 0x3f));
+					}
+				} break;
+				default: return false;
+			}
+		}
+		p++;
+		return true;
+	}
+
+	json_t* parseValue(int depth) {
+		if (depth > 64)
+			return fail("nested too deeply");
+		skipSpace();
+		if (*p == '{') {
+			p++;
+			json_t* object = json_object();
+			skipSpace();
+			if (*p == '}') {
+				p++;
+				return object;
+			}
+			while (true) {
+				skipSpace();
+				std::string key;
+				if (*p != '"' || !parseString(key)) {
+					json_decref(object);
+					return fail("expected a key");
+				}
+				skipSpace();
+				if (*p++ != ':') {
+					json_decref(object);
+					return fail("expected ':'");
+				}
+				json_t* value = parseValue(depth + 1);
+				if (!value) {
+					json_decref(object);
+					return NULL;
+				}
+				json_object_set_new(object, key.c_str(), value);
+				skipSpace();
+				if (*p == ',') {
+					p++;
+					continue;
+				}
+				if (*p++ == '}')
+					return object;
+				json_decref(object);
+				return fail("expected ',' or '}'");
+			}
+		}
+		if (*p == '[') {
+			p++;
+			json_t* array = json_array();
+			skipSpace();
+			if (*p == ']') {
+				p++;
+				return array;
+			}
+			while (true) {
+				json_t* value = parseValue(depth + 1);
+				if (!value) {
+					json_decref(array);
+					return NULL;
+				}
+				json_array_append_new(array, value);
+				skipSpace();
+				if (*p == ',') {
+					p++;
+					continue;
+				}
+				if (*p++ == ']')
+					return array;
+				json_decref(array);
+				return fail("expected ',' or ']'");
+			}
+		}
+		if (*p == '"') {
+			std::string s;
+			if (!parseString(s))
+				return fail("invalid string");
+			return json_string(s.c_str());
+		}
+		if (literal("true"))
+			return json_true();
+		if (literal("false"))
+			return json_false();
+		if (literal("null"))
+			return json_null();
+		if (*p == '-' || std::isdigit((unsigned char) *p)) {
+			const char* numberStart = p;
+			if (*p == '-')
+				p++;
+			bool real = false;
+			while (std::isdigit((unsigned char) *p) || *p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-') {
+				real |= *p == '.' || *p == 'e' || *p == 'E';
+				p++;
+			}
+			std::string number(numberStart, p);
+			char* end;
+			if (real) {
+				double value = std::strtod(number.c_str(), &end);
+				return *end ? fail("invalid number") : json_real(value);
+			}
+			json_int_t value = std::strtoll(number.c_str(), &end, 10);
+			return *end ? fail("invalid number") : json_integer(value);
+		}
+		return fail("unexpected character");
+	}
+};
+
+} // namespace
+
+json_t* json_loads(const char* input, size_t flags, json_error_t* error) {
+	JsonParser parser;
+	parser.p = parser.start = input;
+	json_t* json = parser.parseValue(0);
+	if (json) {
+		parser.skipSpace();
+		if (*parser.p != '\0') {
+			json_decref(json);
+			json = parser.fail("end of input expected");
+		}
+	}
+	if (!json && error) {
+		std::memset(error, 0, sizeof(*error));
+		error->position = (int) (parser.p - parser.start);
+		error->column = error->position;
+		std::snprintf(error->source, sizeof(error->source), "<string>");
+		std::snprintf(error->text, sizeof(error->text), "%s", parser.error.c_str());
+	}
+	return json;
+}
+
+// the tools' side
+
+namespace headless {
+
+namespace {
+
+/** A context menu keeps the widget it was built from, the items' actions
+ *  may refer to it.
+ */
+struct ContextMenu : rack::ui::Menu {
+	rack::app::ModuleWidget* moduleWidget = NULL;
+
+	~ContextMenu() {
+		clearChildren();
+		delete moduleWidget;
+	}
+};
+
+int findPort(const std::vector<rack::engine::PortInfo*>& infos, const std::string& name, const char* kind, rack::engine::Module* module) {
+	for (size_t i = 0; i < infos.size(); i++) {
+		if (infos[i] && infos[i]->name == name)
+			return i;
+	}
+	std::fprintf(stderr, "%s has no %s named \"%s\"\n", module->model->slug.c_str(), kind, name.c_str());
+	std::exit(1);
+}
+
+void collectActions(rack::ui::Menu* menu, std::vector<std::string>& path, std::vector<std::vector<std::string>>& actions) {
+	for (rack::widget::Widget* child : menu->children) {
+		rack::ui::MenuItem* item = dynamic_cast<rack::ui::MenuItem*>(child);
+		if (!item || item->disabled)
+			continue;
+		path.push_back(item->text);
+		std::unique_ptr<rack::ui::Menu> submenu(item->createChildMenu());
+		if (submenu)
+			collectActions(submenu.get(), path, actions);
+		else
+			actions.push_back(path);
+		path.pop_back();
+	}
+}
+
+rack::ui::MenuItem* findItem(rack::ui::Menu* menu, const std::string& text) {
+	for (rack::widget::Widget* child : menu->children) {
+		rack::ui::MenuItem* item = dynamic_cast<rack::ui::MenuItem*>(child);
+		if (item && item->text == text)
+			return item;
+	}
+	return NULL;
+}
+
+} // namespace
+
+static rack::plugin::Plugin* createPlugin() {
+	rack::plugin::Plugin* p = new rack::plugin::Plugin;
+	// tools run from the repository root, where res/ is
+	p->path = ".";
+	p->slug = "NB";
+	::init(p);
+	return p;
+}
+
+rack::plugin::Plugin* plugin() {
+	// initialized once, also when threads ask at the same time
+	static rack::plugin::Plugin* p = createPlugin();
+	return p;
+}
+
+rack::engine::Engine* engine() {
+	return APP->engine;
+}
+
+rack::engine::Module* addModule(const std::string& slug) {
+	rack::plugin::Model* model = plugin()->getModel(slug);
+	if (!model) {
+		std::fprintf(stderr, "No module named %s\n", slug.c_str());
+		std::exit(1);
+	}
+	rack::engine::Module* module = model->createModule();
+	engine()->addModule(module);
+	return module;
+}
+
+int findParam(rack::engine::Module* module, const std::string& name) {
+	for (size_t i = 0; i < module->paramQuantities.size(); i++) {
+		if (module->paramQuantities[i]->name == name)
+			return i;
+	}
+	std::fprintf(stderr, "%s has no param named \"%s\"\n", module->model->slug.c_str(), name.c_str());
+	std::exit(1);
+}
+
+int findInput(rack::engine::Module* module, const std::string& name) {
+	return findPort(module->inputInfos, name, "input", module);
+}
+
+int findOutput(rack::engine::Module* module, const std::string& name) {
+	return findPort(module->outputInfos, name, "output", module);
+}
+
+void addCable(rack::engine::Module* outputModule, int outputId, rack::engine::Module* inputModule, int inputId) {
+	rack::engine::Cable* cable = new rack::engine::Cable;
+	cable->outputModule = outputModule;
+	cable->outputId = outputId;
+	cable->inputModule = inputModule;
+	cable->inputId = inputId;
+	engine()->addCable(cable);
+}
+
+void plugOutput(rack::engine::Module* module, int outputId) {
+	rack::engine::Output& output = module->outputs[outputId];
+	if (output.channels == 0)
+		output.channels = 1;
+}
+
+void setInput(rack::engine::Module* module, int inputId, const float* voltages, int channels) {
+	rack::engine::Input& input = module->inputs[inputId];
+	input.channels = channels;
+	for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+		input.voltages[c] = c < channels ? voltages[c] : 0.f;
+	}
+}
+
+bool setModuleData(rack::engine::Module* module, const std::string& json) {
+	json_error_t error;
+	json_t* changesJ = json_loads(json.c_str(), 0, &error);
+	if (!json_is_object(changesJ)) {
+		std::fprintf(stderr, "Bad module data %s: %s\n", json.c_str(), changesJ ? "not an object" : error.text);
+		json_decref(changesJ);
+		return false;
+	}
+	json_t* rootJ = module->dataToJson();
+	if (!rootJ)
+		rootJ = json_object();
+	json_object_update(rootJ, changesJ);
+	module->dataFromJson(rootJ);
+	json_decref(rootJ);
+	json_decref(changesJ);
+	return true;
+}
+
+rack::ui::Menu* createContextMenu(rack::engine::Module* module) {
+	ContextMenu* menu = new ContextMenu;
+	menu->moduleWidget = module->model->createModuleWidget(module);
+	menu->moduleWidget->appendContextMenu(menu);
+	return menu;
+}
+
+std::vector<std::vector<std::string>> menuActions(rack::engine::Module* module) {
+	std::unique_ptr<rack::ui::Menu> menu(createContextMenu(module));
+	std::vector<std::string> path;
+	std::vector<std::vector<std::string>> actions;
+	collectActions(menu.get(), path, actions);
+	return actions;
+}
+
+bool clickMenuItem(rack::engine::Module* module, const std::vector<std::string>& path) {
+	std::vector<std::unique_ptr<rack::ui::Menu>> menus;
+	menus.emplace_back(createContextMenu(module));
+	for (size_t i = 0; i < path.size(); i++) {
+		rack::ui::MenuItem* item = findItem(menus.back().get(), path[i]);
+		if (!item || item->disabled)
+			return false;
+		if (i + 1 == path.size()) {
+			item->onAction(rack::widget::Widget::ActionEvent());
+			return true;
+		}
+		rack::ui::Menu* submenu = item->createChildMenu();
+		if (!submenu)
+			return false;
+		menus.emplace_back(submenu);
+	}
+	return false;
+}
+
+void answerFileDialog(const std::string& path) {
+	fileDialogAnswer = path;
+	fileDialogAnswered = true;
+}
+
+std::string clipboard() {
+	return clipboardText;
+}
+
+} // namespace headless
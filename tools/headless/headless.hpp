@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <rack.hpp>
+
+/** Runs the plugin's real Module and ModuleWidget classes without Rack,
+ *  through the stand-in SDK in tools/headless/include. Tools link the
+ *  plugin's sources and headless.cpp, then build patches with these calls.
+ */
+namespace headless {
+
+/** The plugin with its models registered by init(), created on first use,
+ *  and the engine of the calling thread's context, the one the modules see
+ *  as APP->engine. Threads that call rack::contextSet() run their own.
+ */
+rack::plugin::Plugin* plugin();
+rack::engine::Engine* engine();
+
+/** Creates a module of the model with this slug and adds it to the right
+ *  of the row, or exits when there is no such model.
+ */
+rack::engine::Module* addModule(const std::string& slug);
+
+/** Ids by the names the module configured, or exits when there is none.
+ */
+int findParam(rack::engine::Module* module, const std::string& name);
+int findInput(rack::engine::Module* module, const std::string& name);
+int findOutput(rack::engine::Module* module, const std::string& name);
+
+/** Patches an output to an input of another module.
+ */
+void addCable(rack::engine::Module* outputModule, int outputId, rack::engine::Module* inputModule, int inputId);
+/** Marks an output as patched, like a cable to something outside the
+ *  patch, so the module fills it.
+ */
+void plugOutput(rack::engine::Module* module, int outputId);
+/** Sets an input as if patched from outside the patch, 0 channels unplugs it.
+ */
+void setInput(rack::engine::Module* module, int inputId, const float* voltages, int channels);
+
+/** Merges the keys of a JSON object text into what the module saves and
+ *  loads the result back through dataFromJson, or returns false on bad JSON.
+ */
+bool setModuleData(rack::engine::Module* module, const std::string& json);
+
+/** The context menu Rack would show, the caller deletes it.
+ */
+rack::ui::Menu* createContextMenu(rack::engine::Module* module);
+/** Every enabled item of the context menu that has an action, as the texts
+ *  of the items leading to it.
+ */
+std::vector<std::vector<std::string>> menuActions(rack::engine::Module* module);
+/** Clicks the item at path, or returns false when it is missing or disabled.
+ */
+bool clickMenuItem(rack::engine::Module* module, const std::vector<std::string>& path);
+
+/** The path osdialog_file() returns next, once.
+ */
+void answerFileDialog(const std::string& path);
+/** What the plugin last put on the clipboard.
+ */
+std::string clipboard();
+
+} // namespace headless
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+
+/** The part of the jansson API the plugin and the tools use, implemented
+ *  in headless.cpp with the same ownership rules: the _new setters steal
+ *  the reference, getters borrow one.
+ */
+
+enum json_type {
+	JSON_OBJECT,
+	JSON_ARRAY,
+	JSON_STRING,
+	JSON_INTEGER,
+	JSON_REAL,
+	JSON_TRUE,
+	JSON_FALSE,
+	JSON_NULL
+};
+
+typedef long long json_int_t;
+
+struct json_t {
+	json_type type;
+	size_t refcount;
+};
+
+struct json_error_t {
+	int line;
+	int column;
+	int position;
+	char source[80];
+	char text[160];
+};
+
+#define JSON_INDENT(n) ((n) & 0x1f)
+#define JSON_COMPACT 0x20
+
+json_t* json_object();
+json_t* json_array();
+json_t* json_string(const char* value);
+json_t* json_integer(json_int_t value);
+json_t* json_real(double value);
+json_t* json_true();
+json_t* json_false();
+json_t* json_null();
+#define json_boolean(value) ((value) ? json_true() : json_false())
+
+json_t* json_incref(json_t* json);
+void json_decref(json_t* json);
+json_t* json_deep_copy(const json_t* json);
+
+#define json_typeof(json) ((json)->type)
+#define json_is_object(json) ((json) && json_typeof(json) == JSON_OBJECT)
+#define json_is_array(json) ((json) && json_typeof(json) == JSON_ARRAY)
+#define json_is_string(json) ((json) && json_typeof(json) == JSON_STRING)
+#define json_is_integer(json) ((json) && json_typeof(json) == JSON_INTEGER)
+#define json_is_real(json) ((json) && json_typeof(json) == JSON_REAL)
+#define json_is_number(json) (json_is_integer(json) || json_is_real(json))
+#define json_is_boolean(json) ((json) && (json_typeof(json) == JSON_TRUE || json_typeof(json) == JSON_FALSE))
+#define json_is_null(json) ((json) && json_typeof(json) == JSON_NULL)
+
+size_t json_object_size(const json_t* object);
+json_t* json_object_get(const json_t* object, const char* key);
+int json_object_set_new(json_t* object, const char* key, json_t* value);
+int json_object_set(json_t* object, const char* key, json_t* value);
+int json_object_del(json_t* object, const char* key);
+/** Copies every key of other into object.
+ */
+int json_object_update(json_t* object, json_t* other);
+
+size_t json_array_size(const json_t* array);
+json_t* json_array_get(const json_t* array, size_t index);
+int json_array_append_new(json_t* array, json_t* value);
+int json_array_append(json_t* array, json_t* value);
+
+#define json_array_foreach(array, index, value) \
+	for (index = 0; index < json_array_size(array) && (value = json_array_get(array, index)); index++)
+
+const char* json_string_value(const json_t* string);
+json_int_t json_integer_value(const json_t* integer);
+double json_real_value(const json_t* real);
+double json_number_value(const json_t* json);
+#define json_boolean_value(json) ((json) && json_typeof(json) == JSON_TRUE)
+
+/** The text of json, to be released with free().
+ */
+char* json_dumps(const json_t* json, size_t flags);
+json_t* json_loads(const char* input, size_t flags, json_error_t* error);
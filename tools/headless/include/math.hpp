@@ -0,0 +1,59 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+
+/** The scalar helpers of Rack's math.hpp that the plugin uses, and the
+ *  Vec its widgets are placed with.
+ */
+namespace rack {
+namespace math {
+
+inline int clamp(int x, int a, int b) {
+	return std::max(std::min(x, b), a);
+}
+
+inline float clamp(float x, float a = 0.f, float b = 1.f) {
+	return std::fmax(std::fmin(x, b), a);
+}
+
+inline float rescale(float x, float xMin, float xMax, float yMin, float yMax) {
+	return yMin + (x - xMin) / (xMax - xMin) * (yMax - yMin);
+}
+
+inline float crossfade(float a, float b, float p) {
+	return a + (b - a) * p;
+}
+
+inline bool isNear(float a, float b, float epsilon = 1e-6f) {
+	return std::fabs(a - b) <= epsilon;
+}
+
+/** Euclidean modulus, always between 0 and b - 1.
+ */
+inline int eucMod(int a, int b) {
+	int mod = a % b;
+	return mod < 0 ? mod + b : mod;
+}
+
+struct Vec {
+	float x = 0.f;
+	float y = 0.f;
+
+	Vec() {}
+	Vec(float x, float y) : x(x), y(y) {}
+
+	Vec plus(Vec b) const {
+		return Vec(x + b.x, y + b.y);
+	}
+	Vec mult(float s) const {
+		return Vec(x * s, y * s);
+	}
+};
+
+struct Rect {
+	Vec pos;
+	Vec size;
+};
+
+} // namespace math
+} // namespace rack
@@ -0,0 +1,692 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <list>
+#include <string>
+#include <vector>
+#include <jansson.h>
+#include <math.hpp>
+#include <simd/functions.hpp>
+#include <dsp/common.hpp>
+
+/** A headless stand-in for the Rack SDK, enough of its API to compile the
+ *  plugin's modules, widgets and menus without Rack, a window or a GPU.
+ *  Names and semantics follow Rack v2 so src/ builds unchanged against
+ *  either. The engine steps modules in one thread, see headless.cpp.
+ */
+
+#define LENGTHOF(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define PORT_MAX_CHANNELS 16
+#define RACK_GRID_WIDTH 15
+#define RACK_GRID_HEIGHT 380
+#define CHECKMARK_STRING "✔"
+#define RIGHT_ARROW "▸"
+
+#define DEBUG(format, ...) rack::logger::log(rack::logger::DEBUG_LEVEL, __FILE__, __LINE__, __FUNCTION__, format, ##__VA_ARGS__)
+#define INFO(format, ...) rack::logger::log(rack::logger::INFO_LEVEL, __FILE__, __LINE__, __FUNCTION__, format, ##__VA_ARGS__)
+#define WARN(format, ...) rack::logger::log(rack::logger::WARN_LEVEL, __FILE__, __LINE__, __FUNCTION__, format, ##__VA_ARGS__)
+#define FATAL(format, ...) rack::logger::log(rack::logger::FATAL_LEVEL, __FILE__, __LINE__, __FUNCTION__, format, ##__VA_ARGS__)
+
+struct GLFWwindow;
+void glfwSetClipboardString(GLFWwindow* window, const char* string);
+
+namespace rack {
+
+namespace logger {
+
+enum Level {
+	DEBUG_LEVEL,
+	INFO_LEVEL,
+	WARN_LEVEL,
+	FATAL_LEVEL
+};
+
+__attribute__((format(printf, 5, 6)))
+void log(Level level, const char* filename, int line, const char* func, const char* format, ...);
+
+} // namespace logger
+
+namespace string {
+
+__attribute__((format(printf, 1, 2)))
+std::string f(const char* format, ...);
+
+} // namespace string
+
+namespace system {
+
+std::string getFilename(const std::string& path);
+
+} // namespace system
+
+namespace plugin {
+struct Plugin;
+struct Model;
+} // namespace plugin
+
+namespace asset {
+
+std::string plugin(plugin::Plugin* plugin, const std::string& filename = "");
+std::string user(const std::string& filename = "");
+
+} // namespace asset
+
+namespace engine {
+
+struct Module;
+
+struct Param {
+	float value = 0.f;
+
+	float getValue() {
+		return value;
+	}
+	void setValue(float value) {
+		this->value = value;
+	}
+};
+
+struct Port {
+	union {
+		float voltages[PORT_MAX_CHANNELS] = {};
+		float value;
+	};
+	// 0 while unpatched
+	uint8_t channels = 0;
+
+	void setVoltage(float voltage, int channel = 0) {
+		voltages[channel] = voltage;
+	}
+	float getVoltage(int channel = 0) {
+		return voltages[channel];
+	}
+	float getPolyVoltage(int channel) {
+		return isMonophonic() ? getVoltage(0) : getVoltage(channel);
+	}
+	float getNormalVoltage(float normalVoltage, int channel = 0) {
+		return isConnected() ? getVoltage(channel) : normalVoltage;
+	}
+	float getNormalPolyVoltage(float normalVoltage, int channel) {
+		return isConnected() ? getPolyVoltage(channel) : normalVoltage;
+	}
+	float* getVoltages(int firstChannel = 0) {
+		return &voltages[firstChannel];
+	}
+	template <typename T>
+	T getVoltageSimd(int firstChannel) {
+		return T::load(&voltages[firstChannel]);
+	}
+	template <typename T>
+	void setVoltageSimd(T voltage, int firstChannel) {
+		voltage.store(&voltages[firstChannel]);
+	}
+	/** Like Rack, an unpatched port stays at 0 channels and a patched one
+	 *  at 1 at least.
+	 */
+	void setChannels(int channels) {
+		if (this->channels == 0)
+			return;
+		for (int c = channels; c < this->channels; c++) {
+			voltages[c] = 0.f;
+		}
+		this->channels = channels > 0 ? channels : 1;
+	}
+	int getChannels() {
+		return channels;
+	}
+	bool isConnected() {
+		return channels > 0;
+	}
+	bool isMonophonic() {
+		return channels == 1;
+	}
+	bool isPolyphonic() {
+		return channels > 1;
+	}
+};
+
+struct Output : Port {};
+
+struct Input : Port {};
+
+struct Light {
+	float value = 0.f;
+
+	void setBrightness(float brightness) {
+		value = brightness;
+	}
+	float getBrightness() {
+		return value;
+	}
+};
+
+struct ParamQuantity {
+	Module* module = NULL;
+	int paramId = -1;
+	float minValue = 0.f;
+	float maxValue = 1.f;
+	float defaultValue = 0.f;
+	std::string name;
+	std::string unit;
+	float displayBase = 0.f;
+	float displayMultiplier = 1.f;
+	float displayOffset = 0.f;
+	std::string description;
+	bool snapEnabled = false;
+
+	virtual ~ParamQuantity() {}
+	Param* getParam();
+	/** Clamped to the range, rounded while snapping.
+	 */
+	virtual void setValue(float value);
+	virtual float getValue();
+	virtual float getMinValue() {
+		return minValue;
+	}
+	virtual float getMaxValue() {
+		return maxValue;
+	}
+	virtual float getDefaultValue() {
+		return defaultValue;
+	}
+	virtual float getDisplayValue();
+	virtual std::string getDisplayValueString();
+	virtual std::string getLabel() {
+		return name;
+	}
+};
+
+struct SwitchQuantity : ParamQuantity {
+	std::vector<std::string> labels;
+
+	std::string getDisplayValueString() override;
+};
+
+struct PortInfo {
+	Module* module = NULL;
+	int type = 0;
+	int portId = -1;
+	std::string name;
+	std::string description;
+
+	virtual ~PortInfo() {}
+	virtual std::string getName() {
+		return name;
+	}
+};
+
+struct LightInfo {
+	std::string name;
+};
+
+struct Module {
+	plugin::Model* model = NULL;
+	int64_t id = -1;
+
+	std::vector<Param> params;
+	std::vector<Input> inputs;
+	std::vector<Output> outputs;
+	std::vector<Light> lights;
+	std::vector<ParamQuantity*> paramQuantities;
+	std::vector<PortInfo*> inputInfos;
+	std::vector<PortInfo*> outputInfos;
+	std::vector<LightInfo*> lightInfos;
+
+	struct Expander {
+		int64_t moduleId = -1;
+		Module* module = NULL;
+		void* producerMessage = NULL;
+		void* consumerMessage = NULL;
+		bool messageFlipRequested = false;
+
+		/** Swaps producerMessage and consumerMessage after this frame.
+		 */
+		void requestMessageFlip() {
+			messageFlipRequested = true;
+		}
+	};
+
+	Expander leftExpander;
+	Expander rightExpander;
+
+	Module() {}
+	virtual ~Module();
+
+	void config(int numParams, int numInputs, int numOutputs, int numLights = 0);
+
+	template <class TParamQuantity = ParamQuantity>
+	TParamQuantity* configParam(int paramId, float minValue, float maxValue, float defaultValue, std::string name = "", std::string unit = "", float displayBase = 0.f, float displayMultiplier = 1.f, float displayOffset = 0.f) {
+		delete paramQuantities[paramId];
+		TParamQuantity* q = new TParamQuantity;
+		q->ParamQuantity::module = this;
+		q->ParamQuantity::paramId = paramId;
+		q->ParamQuantity::minValue = minValue;
+		q->ParamQuantity::maxValue = maxValue;
+		q->ParamQuantity::defaultValue = defaultValue;
+		q->ParamQuantity::name = name;
+		q->ParamQuantity::unit = unit;
+		q->ParamQuantity::displayBase = displayBase;
+		q->ParamQuantity::displayMultiplier = displayMultiplier;
+		q->ParamQuantity::displayOffset = displayOffset;
+		paramQuantities[paramId] = q;
+		params[paramId].value = q->getDefaultValue();
+		return q;
+	}
+
+	template <class TSwitchQuantity = SwitchQuantity>
+	TSwitchQuantity* configSwitch(int paramId, float minValue, float maxValue, float defaultValue, std::string name = "", std::vector<std::string> labels = {}) {
+		TSwitchQuantity* sq = configParam<TSwitchQuantity>(paramId, minValue, maxValue, defaultValue, name);
+		sq->snapEnabled = true;
+		sq->labels = labels;
+		return sq;
+	}
+
+	template <class TPortInfo = PortInfo>
+	TPortInfo* configInput(int portId, std::string name = "") {
+		return configPort<TPortInfo>(inputInfos, 0, portId, name);
+	}
+
+	template <class TPortInfo = PortInfo>
+	TPortInfo* configOutput(int portId, std::string name = "") {
+		return configPort<TPortInfo>(outputInfos, 1, portId, name);
+	}
+
+	void configBypass(int inputId, int outputId) {}
+
+	ParamQuantity* getParamQuantity(int index) {
+		return paramQuantities[index];
+	}
+	PortInfo* getInputInfo(int index) {
+		return inputInfos[index];
+	}
+	PortInfo* getOutputInfo(int index) {
+		return outputInfos[index];
+	}
+	Expander& getLeftExpander() {
+		return leftExpander;
+	}
+	Expander& getRightExpander() {
+		return rightExpander;
+	}
+
+	struct ProcessArgs {
+		float sampleRate;
+		float sampleTime;
+		int64_t frame;
+	};
+	virtual void process(const ProcessArgs& args) {}
+
+	virtual json_t* dataToJson() {
+		return NULL;
+	}
+	virtual void dataFromJson(json_t* rootJ) {}
+
+	struct AddEvent {};
+	virtual void onAdd(const AddEvent& e) {}
+	struct RemoveEvent {};
+	virtual void onRemove(const RemoveEvent& e) {}
+	struct ResetEvent {};
+	virtual void onReset(const ResetEvent& e) {}
+	struct SampleRateChangeEvent {
+		float sampleRate;
+		float sampleTime;
+	};
+	virtual void onSampleRateChange(const SampleRateChangeEvent& e) {}
+	struct ExpanderChangeEvent {
+		// 0 for left, 1 for right
+		uint8_t side;
+	};
+	virtual void onExpanderChange(const ExpanderChangeEvent& e) {}
+
+private:
+	template <class TPortInfo>
+	TPortInfo* configPort(std::vector<PortInfo*>& infos, int type, int portId, std::string name) {
+		delete infos[portId];
+		TPortInfo* info = new TPortInfo;
+		info->PortInfo::module = this;
+		info->PortInfo::type = type;
+		info->PortInfo::portId = portId;
+		info->PortInfo::name = name;
+		infos[portId] = info;
+		return info;
+	}
+};
+
+struct Cable {
+	int64_t id = -1;
+	Module* inputModule = NULL;
+	int inputId = -1;
+	Module* outputModule = NULL;
+	int outputId = -1;
+};
+
+/** Steps the modules of a patch. Modules sit in one row in the order they
+ *  were added, so each one is the left expander of the next. Like Rack, a
+ *  cable or an expander message reaches the other module a frame later.
+ *  Stepping neither allocates nor locks, so it may run in a checked audio
+ *  thread, but unlike Rack the engine does not pause for the UI thread.
+ */
+struct Engine {
+	Engine();
+	~Engine();
+
+	/** Takes ownership of the module.
+	 */
+	void addModule(Module* module);
+	void removeModule(Module* module);
+	Module* getModule(int64_t moduleId);
+	std::vector<int64_t> getModuleIds();
+	/** Takes ownership of the cable, the output counts as patched from now on.
+	 */
+	void addCable(Cable* cable);
+	void removeCable(Cable* cable);
+	/** Deletes every module and cable.
+	 */
+	void clear();
+
+	float getSampleRate();
+	float getSampleTime();
+	void setSampleRate(float sampleRate);
+	int64_t getFrame();
+	void stepBlock(int frames);
+
+private:
+	std::vector<Module*> modules;
+	std::vector<Cable*> cables;
+	int64_t nextId = 0;
+	float sampleRate = 48000.f;
+	int64_t frame = 0;
+
+	void updateExpanders();
+};
+
+} // namespace engine
+
+namespace widget {
+
+struct Widget {
+	math::Rect box;
+	Widget* parent = NULL;
+	std::list<Widget*> children;
+
+	virtual ~Widget();
+	/** Takes ownership of the child.
+	 */
+	void addChild(Widget* child);
+	void removeChild(Widget* child);
+	void clearChildren();
+
+	struct ActionEvent {};
+	virtual void onAction(const ActionEvent& e) {}
+};
+
+} // namespace widget
+
+namespace ui {
+
+struct Menu;
+
+struct MenuEntry : widget::Widget {};
+
+struct MenuSeparator : MenuEntry {};
+
+struct MenuLabel : MenuEntry {
+	std::string text;
+};
+
+struct MenuItem : MenuEntry {
+	std::string text;
+	std::string rightText;
+	bool disabled = false;
+
+	/** The submenu, created when the item is hovered in Rack.
+	 */
+	virtual Menu* createChildMenu() {
+		return NULL;
+	}
+};
+
+struct Menu : widget::Widget {};
+
+} // namespace ui
+
+namespace app {
+
+struct ParamWidget : widget::Widget {
+	engine::Module* module = NULL;
+	int paramId = -1;
+
+	engine::ParamQuantity* getParamQuantity();
+	virtual void initParamQuantity() {}
+};
+
+struct Knob : ParamWidget {
+	// rounds the value to integers, through ParamQuantity::snapEnabled
+	bool snap = false;
+
+	void initParamQuantity() override;
+};
+
+struct RoundKnob : Knob {};
+
+struct RoundBlackKnob : RoundKnob {};
+
+struct RoundBlackSnapKnob : RoundBlackKnob {
+	RoundBlackSnapKnob() {
+		snap = true;
+	}
+};
+
+struct Trimpot : Knob {};
+
+struct PortWidget : widget::Widget {
+	engine::Module* module = NULL;
+	int type = 0;
+	int portId = -1;
+};
+
+struct PJ301MPort : PortWidget {};
+
+struct SvgPanel : widget::Widget {};
+
+struct ScrewSilver : widget::Widget {};
+
+struct ModuleWidget : widget::Widget {
+	plugin::Model* model = NULL;
+	engine::Module* module = NULL;
+	widget::Widget* panel = NULL;
+	std::vector<ParamWidget*> params;
+	std::vector<PortWidget*> inputs;
+	std::vector<PortWidget*> outputs;
+
+	void setModel(plugin::Model* model) {
+		this->model = model;
+	}
+	void setModule(engine::Module* module) {
+		this->module = module;
+	}
+	engine::Module* getModule() {
+		return module;
+	}
+	template <class TModule>
+	TModule* getModule() {
+		return dynamic_cast<TModule*>(module);
+	}
+	void setPanel(widget::Widget* panel);
+	void addParam(ParamWidget* param);
+	void addInput(PortWidget* input);
+	void addOutput(PortWidget* output);
+	ParamWidget* getParam(int paramId);
+
+	virtual void appendContextMenu(ui::Menu* menu) {}
+};
+
+} // namespace app
+
+namespace window {
+
+struct Window {
+	GLFWwindow* win = NULL;
+};
+
+inline math::Vec mm2px(math::Vec mm) {
+	return mm.mult(75.f / 25.4f);
+}
+
+} // namespace window
+
+namespace plugin {
+
+struct Model {
+	Plugin* plugin = NULL;
+	std::string slug;
+	std::string name;
+
+	virtual ~Model() {}
+	virtual engine::Module* createModule() {
+		return NULL;
+	}
+	virtual app::ModuleWidget* createModuleWidget(engine::Module* module) {
+		return NULL;
+	}
+};
+
+struct Plugin {
+	std::string path;
+	std::string slug;
+	std::vector<Model*> models;
+
+	~Plugin();
+	void addModel(Model* model);
+	Model* getModel(const std::string& slug);
+};
+
+} // namespace plugin
+
+struct Context {
+	engine::Engine* engine = NULL;
+	window::Window* window = NULL;
+};
+
+/** Like Rack's, the context is per thread. A thread that never sets one
+ *  shares the default context and its engine.
+ */
+Context* contextGet();
+void contextSet(Context* context);
+#define APP rack::contextGet()
+
+// helpers.hpp
+
+template <class TModule, class TModuleWidget>
+plugin::Model* createModel(std::string slug) {
+	struct TModel : plugin::Model {
+		engine::Module* createModule() override {
+			engine::Module* m = new TModule;
+			m->model = this;
+			return m;
+		}
+		app::ModuleWidget* createModuleWidget(engine::Module* m) override {
+			TModule* tm = m ? dynamic_cast<TModule*>(m) : NULL;
+			app::ModuleWidget* mw = new TModuleWidget(tm);
+			mw->setModel(this);
+			return mw;
+		}
+	};
+	plugin::Model* o = new TModel;
+	o->slug = slug;
+	return o;
+}
+
+template <class TWidget>
+TWidget* createWidget(math::Vec pos) {
+	TWidget* o = new TWidget;
+	o->box.pos = pos;
+	return o;
+}
+
+template <class TWidget>
+TWidget* createWidgetCentered(math::Vec pos) {
+	return createWidget<TWidget>(pos);
+}
+
+inline app::SvgPanel* createPanel(std::string svgPath) {
+	return new app::SvgPanel;
+}
+
+template <class TParamWidget>
+TParamWidget* createParam(math::Vec pos, engine::Module* module, int paramId) {
+	TParamWidget* o = new TParamWidget;
+	o->box.pos = pos;
+	o->app::ParamWidget::module = module;
+	o->app::ParamWidget::paramId = paramId;
+	o->initParamQuantity();
+	return o;
+}
+
+template <class TParamWidget>
+TParamWidget* createParamCentered(math::Vec pos, engine::Module* module, int paramId) {
+	return createParam<TParamWidget>(pos, module, paramId);
+}
+
+template <class TPortWidget>
+TPortWidget* createInput(math::Vec pos, engine::Module* module, int inputId) {
+	TPortWidget* o = new TPortWidget;
+	o->box.pos = pos;
+	o->app::PortWidget::module = module;
+	o->app::PortWidget::type = 0;
+	o->app::PortWidget::portId = inputId;
+	return o;
+}
+
+template <class TPortWidget>
+TPortWidget* createInputCentered(math::Vec pos, engine::Module* module, int inputId) {
+	return createInput<TPortWidget>(pos, module, inputId);
+}
+
+template <class TPortWidget>
+TPortWidget* createOutput(math::Vec pos, engine::Module* module, int outputId) {
+	TPortWidget* o = createInput<TPortWidget>(pos, module, outputId);
+	o->app::PortWidget::type = 1;
+	return o;
+}
+
+template <class TPortWidget>
+TPortWidget* createOutputCentered(math::Vec pos, engine::Module* module, int outputId) {
+	return createOutput<TPortWidget>(pos, module, outputId);
+}
+
+ui::MenuLabel* createMenuLabel(std::string text);
+ui::MenuItem* createMenuItem(std::string text, std::string rightText, std::function<void()> action, bool disabled = false, bool alwaysConsume = false);
+ui::MenuItem* createCheckMenuItem(std::string text, std::string rightText, std::function<bool()> checked, std::function<void()> action, bool disabled = false, bool alwaysConsume = false);
+ui::MenuItem* createBoolMenuItem(std::string text, std::string rightText, std::function<bool()> getter, std::function<void(bool)> setter, bool disabled = false, bool alwaysConsume = false);
+ui::MenuItem* createSubmenuItem(std::string text, std::string rightText, std::function<void(ui::Menu* menu)> createMenu, bool disabled = false);
+ui::MenuItem* createIndexSubmenuItem(std::string text, std::vector<std::string> labels, std::function<size_t()> getter, std::function<void(size_t val)> setter, bool disabled = false, bool alwaysConsume = false);
+
+template <typename T>
+ui::MenuItem* createBoolPtrMenuItem(std::string text, std::string rightText, T* ptr) {
+	return createBoolMenuItem(text, rightText,
+		[=]() {return ptr ? *ptr : false;},
+		[=](T val) {if (ptr) *ptr = val;}
+	);
+}
+
+template <typename T>
+ui::MenuItem* createIndexPtrSubmenuItem(std::string text, std::vector<std::string> labels, T* ptr) {
+	return createIndexSubmenuItem(text, labels,
+		[=]() {return ptr ? *ptr : 0;},
+		[=](size_t index) {if (ptr) *ptr = T(index);}
+	);
+}
+
+using namespace math;
+using namespace window;
+using namespace widget;
+using namespace ui;
+using namespace app;
+using plugin::Plugin;
+using plugin::Model;
+using namespace engine;
+
+} // namespace rack
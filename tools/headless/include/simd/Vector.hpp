@@ -0,0 +1,191 @@
+#pragma once
+#include <cstdint>
+#include <x86intrin.h>
+
+/** The part of Rack's simd::Vector the DSP cores use, with the same SSE
+ *  implementation so headless renders match the plugin bit for bit.
+ */
+namespace rack {
+namespace simd {
+
+template <typename T, int N>
+struct Vector;
+
+template <>
+struct Vector<int32_t, 4>;
+
+template <>
+struct Vector<float, 4> {
+	using type = float;
+	constexpr static int size = 4;
+
+	union {
+		__m128 v;
+		float s[4];
+	};
+
+	Vector() = default;
+	Vector(__m128 v) : v(v) {}
+	Vector(float x) {
+		v = _mm_set1_ps(x);
+	}
+	Vector(float x1, float x2, float x3, float x4) {
+		v = _mm_setr_ps(x1, x2, x3, x4);
+	}
+	static Vector zero() {
+		return Vector(_mm_setzero_ps());
+	}
+	static Vector mask() {
+		return Vector(_mm_castsi128_ps(_mm_set1_epi32(-1)));
+	}
+	static Vector load(const float* x) {
+		return Vector(_mm_loadu_ps(x));
+	}
+	void store(float* x) {
+		_mm_storeu_ps(x, v);
+	}
+	float& operator[](int i) {
+		return s[i];
+	}
+	const float& operator[](int i) const {
+		return s[i];
+	}
+	// converts lane values
+	explicit Vector(Vector<int32_t, 4> a);
+	// reinterprets lane bits
+	static Vector cast(Vector<int32_t, 4> a);
+};
+
+template <>
+struct Vector<int32_t, 4> {
+	using type = int32_t;
+	constexpr static int size = 4;
+
+	union {
+		__m128i v;
+		int32_t s[4];
+	};
+
+	Vector() = default;
+	Vector(__m128i v) : v(v) {}
+	Vector(int32_t x) {
+		v = _mm_set1_epi32(x);
+	}
+	Vector(int32_t x1, int32_t x2, int32_t x3, int32_t x4) {
+		v = _mm_setr_epi32(x1, x2, x3, x4);
+	}
+	static Vector zero() {
+		return Vector(_mm_setzero_si128());
+	}
+	static Vector mask() {
+		return Vector(_mm_set1_epi32(-1));
+	}
+	static Vector load(const int32_t* x) {
+		return Vector(_mm_loadu_si128((const __m128i*) x));
+	}
+	void store(int32_t* x) {
+		_mm_storeu_si128((__m128i*) x, v);
+	}
+	int32_t& operator[](int i) {
+		return s[i];
+	}
+	const int32_t& operator[](int i) const {
+		return s[i];
+	}
+	// truncates like a scalar cast
+	explicit Vector(Vector<float, 4> a);
+	static Vector cast(Vector<float, 4> a);
+};
+
+inline Vector<float, 4>::Vector(Vector<int32_t, 4> a) {
+	v = _mm_cvtepi32_ps(a.v);
+}
+
+inline Vector<float, 4> Vector<float, 4>::cast(Vector<int32_t, 4> a) {
+	return Vector(_mm_castsi128_ps(a.v));
+}
+
+inline Vector<int32_t, 4>::Vector(Vector<float, 4> a) {
+	v = _mm_cvttps_epi32(a.v);
+}
+
+inline Vector<int32_t, 4> Vector<int32_t, 4>::cast(Vector<float, 4> a) {
+	return Vector(_mm_castps_si128(a.v));
+}
+
+typedef Vector<float, 4> float_4;
+typedef Vector<int32_t, 4> int32_4;
+
+// Operators are free functions so a scalar converts on either side,
+// comparisons return all-ones lanes where true.
+
+#define NB_SIMD_BINARY(T, op, fn) \
+	inline T operator op(const T& a, const T& b) { \
+		return T(fn(a.v, b.v)); \
+	} \
+	inline T& operator op##=(T& a, const T& b) { \
+		a = a op b; \
+		return a; \
+	}
+
+NB_SIMD_BINARY(float_4, +, _mm_add_ps)
+NB_SIMD_BINARY(float_4, -, _mm_sub_ps)
+NB_SIMD_BINARY(float_4, *, _mm_mul_ps)
+NB_SIMD_BINARY(float_4, /, _mm_div_ps)
+NB_SIMD_BINARY(float_4, &, _mm_and_ps)
+NB_SIMD_BINARY(float_4, |, _mm_or_ps)
+NB_SIMD_BINARY(float_4, ^, _mm_xor_ps)
+NB_SIMD_BINARY(int32_4, +, _mm_add_epi32)
+NB_SIMD_BINARY(int32_4, -, _mm_sub_epi32)
+NB_SIMD_BINARY(int32_4, *, _mm_mullo_epi32)
+NB_SIMD_BINARY(int32_4, &, _mm_and_si128)
+NB_SIMD_BINARY(int32_4, |, _mm_or_si128)
+NB_SIMD_BINARY(int32_4, ^, _mm_xor_si128)
+#undef NB_SIMD_BINARY
+
+#define NB_SIMD_COMPARE(T, op, fn) \
+	inline T operator op(const T& a, const T& b) { \
+		return T(fn(a.v, b.v)); \
+	}
+
+NB_SIMD_COMPARE(float_4, ==, _mm_cmpeq_ps)
+NB_SIMD_COMPARE(float_4, !=, _mm_cmpneq_ps)
+NB_SIMD_COMPARE(float_4, <, _mm_cmplt_ps)
+NB_SIMD_COMPARE(float_4, >, _mm_cmpgt_ps)
+NB_SIMD_COMPARE(float_4, <=, _mm_cmple_ps)
+NB_SIMD_COMPARE(float_4, >=, _mm_cmpge_ps)
+NB_SIMD_COMPARE(int32_4, ==, _mm_cmpeq_epi32)
+NB_SIMD_COMPARE(int32_4, <, _mm_cmplt_epi32)
+NB_SIMD_COMPARE(int32_4, >, _mm_cmpgt_epi32)
+#undef NB_SIMD_COMPARE
+
+inline float_4 operator+(const float_4& a) {
+	return a;
+}
+
+inline float_4 operator-(const float_4& a) {
+	return 0.f - a;
+}
+
+inline float_4 operator~(const float_4& a) {
+	return a ^ float_4::mask();
+}
+
+inline int32_4 operator-(const int32_4& a) {
+	return 0 - a;
+}
+
+inline int32_4 operator~(const int32_4& a) {
+	return a ^ int32_4::mask();
+}
+
+inline int32_4 operator<<(const int32_4& a, int b) {
+	return int32_4(_mm_slli_epi32(a.v, b));
+}
+
+inline int32_4 operator>>(const int32_4& a, int b) {
+	return int32_4(_mm_srai_epi32(a.v, b));
+}
+
+} // namespace simd
+} // namespace rack
@@ -0,0 +1,134 @@
+#pragma once
+#include <cmath>
+#include <simd/Vector.hpp>
+#include <simd/sse_mathfun.h>
+
+/** The part of Rack's simd functions the DSP cores use. Each float_4
+ *  overload mirrors Rack's own, the scalar ones come from std:: like there.
+ */
+namespace rack {
+namespace simd {
+
+using std::ceil;
+using std::cos;
+using std::exp;
+using std::exp2;
+using std::fabs;
+using std::floor;
+using std::fmax;
+using std::fmin;
+using std::log;
+using std::log2;
+using std::pow;
+using std::round;
+using std::sin;
+using std::sqrt;
+using std::tanh;
+using std::trunc;
+
+inline float ifelse(bool mask, float a, float b) {
+	return mask ? a : b;
+}
+
+/** a where mask lanes are all ones, b where they are zero.
+ */
+inline float_4 ifelse(float_4 mask, float_4 a, float_4 b) {
+	return (a & mask) | float_4(_mm_andnot_ps(mask.v, b.v));
+}
+
+inline int32_4 ifelse(int32_4 mask, int32_4 a, int32_4 b) {
+	return (a & mask) | int32_4(_mm_andnot_si128(mask.v, b.v));
+}
+
+/** The sign bits of the lanes, lane 0 in bit 0.
+ */
+inline int movemask(float_4 a) {
+	return _mm_movemask_ps(a.v);
+}
+
+inline int movemask(int32_4 a) {
+	return _mm_movemask_ps(_mm_castsi128_ps(a.v));
+}
+
+inline float_4 fmax(float_4 a, float_4 b) {
+	return float_4(_mm_max_ps(a.v, b.v));
+}
+
+inline float_4 fmin(float_4 a, float_4 b) {
+	return float_4(_mm_min_ps(a.v, b.v));
+}
+
+inline float_4 clamp(float_4 x, float_4 a = 0.f, float_4 b = 1.f) {
+	return fmin(fmax(x, a), b);
+}
+
+inline float_4 fabs(float_4 a) {
+	return a & float_4::cast(int32_4(0x7fffffff));
+}
+
+inline float_4 trunc(float_4 a) {
+	return float_4(_mm_cvtepi32_ps(_mm_cvttps_epi32(a.v)));
+}
+
+inline float_4 floor(float_4 a) {
+	float_4 b = trunc(a);
+	return b - (float_4(1.f) & (b > a));
+}
+
+inline float_4 ceil(float_4 a) {
+	float_4 b = trunc(a);
+	return b + (float_4(1.f) & (b < a));
+}
+
+inline float_4 round(float_4 a) {
+	return trunc(a + ifelse(a < 0.f, -.5f, .5f));
+}
+
+inline float_4 sqrt(float_4 a) {
+	return float_4(_mm_sqrt_ps(a.v));
+}
+
+/** Approximate 1 / a, about 12 bits.
+ */
+inline float_4 rcp(float_4 a) {
+	return float_4(_mm_rcp_ps(a.v));
+}
+
+/** Approximate 1 / sqrt(a), about 12 bits.
+ */
+inline float_4 rsqrt(float_4 a) {
+	return float_4(_mm_rsqrt_ps(a.v));
+}
+
+inline float_4 exp(float_4 a) {
+	return float_4(sse_mathfun_exp_ps(a.v));
+}
+
+inline float_4 log(float_4 a) {
+	return float_4(sse_mathfun_log_ps(a.v));
+}
+
+inline float_4 pow(float_4 a, float_4 b) {
+	return exp(b * log(a));
+}
+
+inline float_4 pow(float a, float_4 b) {
+	return exp(b * std::log(a));
+}
+
+inline float_4 sgn(float_4 a) {
+	float_4 sign = a & float_4(-0.f);
+	float_4 nonZero = a != 0.f;
+	return (float_4(1.f) | sign) & nonZero;
+}
+
+inline float_4 crossfade(float_4 a, float_4 b, float_4 p) {
+	return a + (b - a) * p;
+}
+
+inline float_4 rescale(float_4 x, float_4 xMin, float_4 xMax, float_4 yMin, float_4 yMax) {
+	return yMin + (x - xMin) / (xMax - xMin) * (yMax - yMin);
+}
+
+} // namespace simd
+} // namespace rack
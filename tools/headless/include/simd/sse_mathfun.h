@@ -0,0 +1,77 @@
+#pragma once
+#include <x86intrin.h>
+
+/** exp() and log() for four floats, Julien Pommier's sse_mathfun port of
+ *  the Cephes polynomials that Rack's simd::exp and simd::log use.
+ */
+
+inline __m128 sse_mathfun_log_ps(__m128 x) {
+	__m128 one = _mm_set1_ps(1.f);
+	__m128 invalid_mask = _mm_cmple_ps(x, _mm_setzero_ps());
+	// cut off denormals
+	x = _mm_max_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x00800000)));
+
+	__m128i emm0 = _mm_srli_epi32(_mm_castps_si128(x), 23);
+	// keep only the fractional part
+	x = _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(~0x7f800000)));
+	x = _mm_or_ps(x, _mm_set1_ps(.5f));
+	emm0 = _mm_sub_epi32(emm0, _mm_set1_epi32(0x7f));
+	__m128 e = _mm_add_ps(_mm_cvtepi32_ps(emm0), one);
+
+	// x < sqrt(1/2) ? e -= 1, x = x + x - 1 : x = x - 1
+	__m128 mask = _mm_cmplt_ps(x, _mm_set1_ps(0.707106781186547524f));
+	__m128 tmp = _mm_and_ps(x, mask);
+	x = _mm_sub_ps(x, one);
+	e = _mm_sub_ps(e, _mm_and_ps(one, mask));
+	x = _mm_add_ps(x, tmp);
+
+	__m128 z = _mm_mul_ps(x, x);
+	__m128 y = _mm_set1_ps(7.0376836292E-2f);
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.1514610310E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.1676998740E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.2420140846E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.4249322787E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.6668057665E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(2.0000714765E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-2.4999993993E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(3.3333331174E-1f));
+	y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+
+	y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(-2.12194440e-4f)));
+	y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(.5f)));
+	x = _mm_add_ps(x, y);
+	x = _mm_add_ps(x, _mm_mul_ps(e, _mm_set1_ps(0.693359375f)));
+	// NaN for x <= 0
+	return _mm_or_ps(x, invalid_mask);
+}
+
+inline __m128 sse_mathfun_exp_ps(__m128 x) {
+	__m128 one = _mm_set1_ps(1.f);
+	x = _mm_min_ps(x, _mm_set1_ps(88.3762626647949f));
+	x = _mm_max_ps(x, _mm_set1_ps(-88.3762626647949f));
+
+	// exp(x) = exp(g + n * log(2))
+	__m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(.5f));
+	__m128 tmp = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+	// floor, the conversion truncates towards zero
+	__m128 mask = _mm_and_ps(_mm_cmpgt_ps(tmp, fx), one);
+	fx = _mm_sub_ps(tmp, mask);
+
+	x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(0.693359375f)));
+	x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(-2.12194440e-4f)));
+	__m128 z = _mm_mul_ps(x, x);
+
+	__m128 y = _mm_set1_ps(1.9875691500E-4f);
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507E-3f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073E-3f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894E-2f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201E-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, z), x);
+	y = _mm_add_ps(y, one);
+
+	// 2^n
+	__m128i emm0 = _mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(0x7f));
+	emm0 = _mm_slli_epi32(emm0, 23);
+	return _mm_mul_ps(y, _mm_castsi128_ps(emm0));
+}
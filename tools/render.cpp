@@ -0,0 +1,574 @@
+/** Offline renders of the plugin's modules, checked against stored
+ *  reference files.
+ *
+ * Build and run with `make render`, or `make render-update` to rewrite the
+ * references. Usage:
+ *   render [options] SCRIPT...
+ * Each script is one job, rendered faster than realtime on its own thread
+ * and written to OUT/NAME.wav, where NAME is the script's file name without
+ * its extension. Options:
+ *   --jobs N        render N scripts at a time (default: one per core)
+ *   --out DIR       where the renders go (default build/render)
+ *   --ref DIR       reference renders to diff against (default tools/render/golden)
+ *   --update        write the renders to the reference directory instead
+ *   --tolerance X   largest difference in volts that still passes (default
+ *                   1e-4, for compilers that round the same code differently)
+ *   --cpu LEVEL     kernel build to run, baseline or avx2 (default baseline,
+ *                   which the references are rendered with since the AVX2
+ *                   build contracts to FMA and rounds differently), see
+ *                   src/cpudispatch.h
+ * Prints one CSV row per job,
+ *   job,frames,render_seconds,realtime_factor,max_diff,result
+ * and exits with 1 when any job fails. A job without a reference is
+ * reported as skip and does not fail the run.
+ *
+ * The jobs run the real Polyfotz, VarTriSaw and Softclip modules in the
+ * headless engine of tools/headless, one engine per job: process(), the
+ * cables, the expander bus between Polyfotz and VarTriSaw and the
+ * settings loaded through dataFromJson(). See tools/render/ for the script
+ * format.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <direct.h>
+#endif
+#include "harness.hpp"
+#include "headless.hpp"
+#include "cpudispatch.h"
+
+using namespace harness;
+
+/** A control signal, held between events or ramped linearly into the ones
+ *  marked ramp.
+ */
+struct Track {
+	struct Point {
+		double time;
+		float value;
+		bool ramp;
+	};
+	std::vector<Point> points;
+	size_t cursor = 0;
+
+	/** Values for increasing times only.
+	 */
+	float at(double time) {
+		while (cursor + 1 < points.size() && points[cursor + 1].time <= time) {
+			cursor++;
+		}
+		const Point& p = points[cursor];
+		if (cursor + 1 < points.size() && points[cursor + 1].ramp) {
+			const Point& next = points[cursor + 1];
+			return p.value + (next.value - p.value) * (float)((time - p.time) / (next.time - p.time));
+		}
+		return p.value;
+	}
+};
+
+// the modules a chain can hold, in patch order
+static const char* const CHAIN_NAMES[] = {"polyfotz", "vartrisaw", "softclip"};
+static const char* const CHAIN_SLUGS[] = {"Polyfotz", "VarTriSaw", "softclip"};
+enum ChainModule {
+	POLYFOTZ,
+	VARTRISAW,
+	SOFTCLIP,
+	CHAIN_LEN
+};
+
+/** A knob or CV a script can automate. It goes to the first module of the
+ *  chain that has it. Inputs with a default are patched with it even when
+ *  the script never sets them, the others only when it does.
+ */
+struct Control {
+	const char* name;
+	struct Target {
+		int module;
+		bool input;
+		const char* name;
+	};
+	Target targets[2];
+	float defaultValue;
+};
+
+static const Control CONTROLS[] = {
+	{"voct", {{POLYFOTZ, true, "V/OCT"}, {VARTRISAW, true, "v/oct"}}, 0.f},
+	{"aft", {{POLYFOTZ, true, "aftertouch"}, {VARTRISAW, true, "aftertouch"}}, 10.f},
+	{"pitchwheel", {{POLYFOTZ, true, "pitchwheel"}, {-1}}, NAN},
+	{"voicing", {{POLYFOTZ, false, "voicing selection"}, {-1}}, NAN},
+	{"transpose", {{POLYFOTZ, false, "transpose by semitones"}, {-1}}, NAN},
+	{"tune", {{POLYFOTZ, false, "fine tune"}, {-1}}, NAN},
+	{"detune", {{POLYFOTZ, false, "detune spread"}, {-1}}, NAN},
+	{"octave", {{POLYFOTZ, false, "transpose by octave"}, {-1}}, NAN},
+	{"aftrand", {{POLYFOTZ, false, "aftertouch randomization"}, {-1}}, NAN},
+	{"gain", {{VARTRISAW, false, "gain"}, {-1}}, NAN},
+	{"drive", {{SOFTCLIP, false, "gain"}, {-1}}, NAN},
+	{"hardness", {{SOFTCLIP, false, "knee hardness"}, {-1}}, NAN},
+};
+static const int CONTROLS_LEN = LENGTHOF(CONTROLS);
+
+struct Job {
+	std::string name;
+	std::string path;
+	// script
+	bool chain[CHAIN_LEN] = {};
+	// Polyfotz plays VarTriSaw through the expander bus instead of cables
+	bool bus = false;
+	bool squareOut = false;
+	double length = 1.0;
+	float sampleRate = SAMPLE_RATE;
+	// JSON objects for each module's dataFromJson(), in script order
+	std::vector<std::string> settings[CHAIN_LEN];
+	Track tracks[CONTROLS_LEN];
+	// results
+	std::vector<float> samples;
+	double seconds = 0.0;
+	double maxDiff = 0.0;
+	std::string result;
+};
+
+static bool parseError(const Job& job, int lineNumber, const std::string& message) {
+	std::fprintf(stderr, "%s:%d: %s\n", job.path.c_str(), lineNumber, message.c_str());
+	return false;
+}
+
+/** The module and id a control goes to in this job's chain, or false.
+ */
+static bool controlTarget(const Job& job, int c, int* module, bool* input, const char** name) {
+	for (const Control::Target& target : CONTROLS[c].targets) {
+		if (target.module >= 0 && job.chain[target.module]) {
+			*module = target.module;
+			*input = target.input;
+			*name = target.name;
+			return true;
+		}
+	}
+	return false;
+}
+
+/** Reads a script. One directive or event per line, # starts a comment:
+ *   chain MODULE...           polyfotz, vartrisaw and softclip, in patch order
+ *   bus                       put Polyfotz next to VarTriSaw instead of
+ *                             patching it
+ *   output saw|sqr            the VarTriSaw output that is rendered
+ *   length SECONDS
+ *   rate HZ
+ *   set MODULE KEY JSON       a key of what the module saves in the patch,
+ *                             e.g. set vartrisaw unison 4
+ *   TIME CONTROL VALUE [ramp] a knob or CV from TIME seconds on
+ */
+static bool parseScript(Job& job) {
+	std::ifstream in(job.path);
+	if (!in) {
+		std::fprintf(stderr, "Could not open %s\n", job.path.c_str());
+		return false;
+	}
+	std::vector<std::pair<int, std::string>> settings;
+	std::string line;
+	for (int lineNumber = 1; std::getline(in, line); lineNumber++) {
+		line = line.substr(0, line.find('#'));
+		std::istringstream fields(line);
+		std::string word;
+		if (!(fields >> word))
+			continue;
+
+		if (word == "chain") {
+			int next = 0;
+			while (fields >> word) {
+				while (next < CHAIN_LEN && word != CHAIN_NAMES[next]) {
+					next++;
+				}
+				if (next == CHAIN_LEN)
+					return parseError(job, lineNumber, "unknown module or wrong order: " + word);
+				job.chain[next++] = true;
+			}
+			continue;
+		}
+		if (word == "bus") {
+			job.bus = true;
+			continue;
+		}
+		if (word == "output") {
+			fields >> word;
+			if (word != "saw" && word != "sqr")
+				return parseError(job, lineNumber, "output is saw or sqr");
+			job.squareOut = word == "sqr";
+			continue;
+		}
+		if (word == "length") {
+			if (!(fields >> job.length) || job.length <= 0.0)
+				return parseError(job, lineNumber, "length needs seconds");
+			continue;
+		}
+		if (word == "rate") {
+			if (!(fields >> job.sampleRate) || job.sampleRate < 1000.f)
+				return parseError(job, lineNumber, "rate needs a sample rate");
+			continue;
+		}
+		if (word == "set") {
+			std::string module, key, value;
+			if (!(fields >> module >> key) || !std::getline(fields >> std::ws, value))
+				return parseError(job, lineNumber, "set needs a module, a key and a value");
+			int m = std::find(CHAIN_NAMES, CHAIN_NAMES + CHAIN_LEN, module) - CHAIN_NAMES;
+			if (m == CHAIN_LEN)
+				return parseError(job, lineNumber, "unknown module " + module);
+			std::string object = "{\"" + key + "\": " + value + "}";
+			json_error_t error;
+			json_t* objectJ = json_loads(object.c_str(), 0, &error);
+			if (!objectJ)
+				return parseError(job, lineNumber, "the value is not JSON: " + value);
+			json_decref(objectJ);
+			settings.push_back(std::make_pair(m, object));
+			continue;
+		}
+
+		// an event
+		double time = std::strtod(word.c_str(), NULL);
+		std::string control, ramp;
+		float value;
+		if (!(fields >> control >> value))
+			return parseError(job, lineNumber, "expected TIME CONTROL VALUE [ramp]");
+		fields >> ramp;
+		int c = 0;
+		while (c < CONTROLS_LEN && control != CONTROLS[c].name) {
+			c++;
+		}
+		if (c == CONTROLS_LEN)
+			return parseError(job, lineNumber, "unknown control " + control);
+		std::vector<Track::Point>& points = job.tracks[c].points;
+		// NAN is filled in from the module by render()
+		if (points.empty())
+			points.push_back({0.0, CONTROLS[c].defaultValue, false});
+		if (time < points.back().time)
+			return parseError(job, lineNumber, "events of a control must be in time order");
+		bool ramped = ramp == "ramp" && time > points.back().time;
+		points.push_back({time, value, ramped});
+	}
+	if (!job.chain[VARTRISAW])
+		return parseError(job, 0, "the chain needs vartrisaw");
+	for (const std::pair<int, std::string>& setting : settings) {
+		if (!job.chain[setting.first])
+			return parseError(job, 0, std::string("set for a module not in the chain: ") + CHAIN_NAMES[setting.first]);
+		job.settings[setting.first].push_back(setting.second);
+	}
+	for (int c = 0; c < CONTROLS_LEN; c++) {
+		int module;
+		bool input;
+		const char* name;
+		if (job.tracks[c].points.empty()) {
+			if (std::isnan(CONTROLS[c].defaultValue))
+				continue;
+			job.tracks[c].points.push_back({0.0, CONTROLS[c].defaultValue, false});
+		}
+		if (!controlTarget(job, c, &module, &input, &name))
+			return parseError(job, 0, std::string("no module in the chain takes ") + CONTROLS[c].name);
+	}
+	return true;
+}
+
+/** Renders a job's script into job.samples, Softclip's mix output, or the
+ *  average of the VarTriSaw output's channels without Softclip. Runs on
+ *  its own engine, so jobs can render on several threads at once.
+ */
+static void render(Job& job) {
+	using namespace rack;
+	engine::Engine engine;
+	Context context;
+	context.engine = &engine;
+	contextSet(&context);
+	engine.setSampleRate(job.sampleRate);
+
+	engine::Module* modules[CHAIN_LEN] = {};
+	for (int m = 0; m < CHAIN_LEN; m++) {
+		if (!job.chain[m])
+			continue;
+		modules[m] = headless::addModule(CHAIN_SLUGS[m]);
+		for (const std::string& setting : job.settings[m]) {
+			headless::setModuleData(modules[m], setting);
+		}
+	}
+	engine::Module* vartrisaw = modules[VARTRISAW];
+	int vartrisawOut = headless::findOutput(vartrisaw, job.squareOut ? "pwm square" : "pwm triSaw");
+	if (modules[POLYFOTZ] && !job.bus) {
+		// next to each other the bus would carry the voices, the patched
+		// V/Oct makes VarTriSaw play from the cables instead
+		engine::Module* polyfotz = modules[POLYFOTZ];
+		headless::addCable(polyfotz, headless::findOutput(polyfotz, "polyphonic"), vartrisaw, headless::findInput(vartrisaw, "v/oct"));
+		headless::addCable(polyfotz, headless::findOutput(polyfotz, "polyphonic aftertouch"), vartrisaw, headless::findInput(vartrisaw, "aftertouch"));
+		headless::addCable(polyfotz, headless::findOutput(polyfotz, "polyphonic gain"), vartrisaw, headless::findInput(vartrisaw, "poly gain in"));
+	}
+	engine::Output* out;
+	if (modules[SOFTCLIP]) {
+		engine::Module* softclip = modules[SOFTCLIP];
+		headless::addCable(vartrisaw, vartrisawOut, softclip, headless::findInput(softclip, "input"));
+		int mixOut = headless::findOutput(softclip, "mixoutput");
+		headless::plugOutput(softclip, mixOut);
+		out = &softclip->outputs[mixOut];
+	}
+	else {
+		headless::plugOutput(vartrisaw, vartrisawOut);
+		out = &vartrisaw->outputs[vartrisawOut];
+	}
+
+	// where each automated control goes
+	struct Binding {
+		Track* track;
+		engine::Module* module;
+		bool input;
+		int id;
+	};
+	std::vector<Binding> bindings;
+	for (int c = 0; c < CONTROLS_LEN; c++) {
+		int module;
+		bool input;
+		const char* name;
+		if (job.tracks[c].points.empty() || !controlTarget(job, c, &module, &input, &name))
+			continue;
+		// the cables from Polyfotz already feed VarTriSaw
+		if (module == VARTRISAW && input && modules[POLYFOTZ])
+			continue;
+		engine::Module* m = modules[module];
+		Binding binding = {&job.tracks[c], m, input, input ? headless::findInput(m, name) : headless::findParam(m, name)};
+		// until the first event, a knob stays at its default and a CV at 0 V
+		Track::Point& first = binding.track->points[0];
+		if (std::isnan(first.value))
+			first.value = input ? 0.f : m->params[binding.id].getValue();
+		bindings.push_back(binding);
+	}
+
+	long frames = (long)(job.length * job.sampleRate);
+	job.samples.resize(frames);
+	auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < frames; i++) {
+		double time = i / (double)job.sampleRate;
+		for (Binding& binding : bindings) {
+			float value = binding.track->at(time);
+			if (binding.input)
+				headless::setInput(binding.module, binding.id, &value, 1);
+			else
+				binding.module->params[binding.id].setValue(value);
+		}
+		engine.stepBlock(1);
+		if (modules[SOFTCLIP]) {
+			job.samples[i] = out->getVoltage();
+		}
+		else {
+			int channels = out->getChannels();
+			float mix = 0.f;
+			for (int c = 0; c < channels; c++) {
+				mix += out->getVoltage(c);
+			}
+			job.samples[i] = channels > 0 ? mix / channels : 0.f;
+		}
+	}
+	job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	engine.clear();
+	contextSet(NULL);
+}
+
+static void put16(std::ofstream& out, uint16_t x) {
+	char bytes[2] = {(char)(x & 0xff), (char)(x >> 8)};
+	out.write(bytes, 2);
+}
+
+static void put32(std::ofstream& out, uint32_t x) {
+	put16(out, x & 0xffff);
+	put16(out, x >> 16);
+}
+
+static uint32_t get32(const char* p) {
+	const uint8_t* b = (const uint8_t*) p;
+	return b[0] | b[1] << 8 | b[2] << 16 | (uint32_t) b[3] << 24;
+}
+
+/** Mono 32 bit float WAV.
+ */
+static bool writeWav(const std::string& path, const std::vector<float>& samples, float sampleRate) {
+	std::ofstream out(path, std::ios::binary);
+	uint32_t dataSize = samples.size() * 4;
+	out.write("RIFF", 4);
+	put32(out, 4 + 8 + 16 + 8 + dataSize);
+	out.write("WAVE", 4);
+	out.write("fmt ", 4);
+	put32(out, 16);
+	// IEEE float, one channel
+	put16(out, 3);
+	put16(out, 1);
+	put32(out, (uint32_t) sampleRate);
+	put32(out, (uint32_t) sampleRate * 4);
+	put16(out, 4);
+	put16(out, 32);
+	out.write("data", 4);
+	put32(out, dataSize);
+	for (float x : samples) {
+		uint32_t bits;
+		std::memcpy(&bits, &x, 4);
+		put32(out, bits);
+	}
+	return (bool) out;
+}
+
+/** Reads back what writeWav() wrote, skipping any other chunks.
+ */
+static bool readWav(const std::string& path, std::vector<float>* samples) {
+	std::ifstream in(path, std::ios::binary);
+	std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if (data.size() < 12 || data.compare(0, 4, "RIFF") != 0 || data.compare(8, 4, "WAVE") != 0)
+		return false;
+	bool isFloat = false;
+	for (size_t p = 12; p + 8 <= data.size();) {
+		uint32_t size = get32(&data[p + 4]);
+		if (size > data.size() - p - 8)
+			return false;
+		const char* chunk = &data[p + 8];
+		if (data.compare(p, 4, "fmt ") == 0 && size >= 16) {
+			isFloat = (get32(chunk) & 0xffff) == 3 && (get32(chunk) >> 16) == 1 && (get32(chunk + 12) >> 16) == 32;
+		}
+		else if (data.compare(p, 4, "data") == 0) {
+			if (!isFloat)
+				return false;
+			samples->resize(size / 4);
+			for (size_t i = 0; i < samples->size(); i++) {
+				uint32_t bits = get32(chunk + 4 * i);
+				std::memcpy(&(*samples)[i], &bits, 4);
+			}
+			return true;
+		}
+		p += 8 + size + (size & 1);
+	}
+	return false;
+}
+
+static void makeDirs(const std::string& path) {
+	for (size_t i = 1; i <= path.size(); i++) {
+		if (i == path.size() || path[i] == '/') {
+#if defined(_WIN32)
+			_mkdir(path.substr(0, i).c_str());
+#else
+			mkdir(path.substr(0, i).c_str(), 0755);
+#endif
+		}
+	}
+}
+
+/** Largest sample difference, infinite when the lengths differ or only one
+ *  side is NaN.
+ */
+static double maxDiff(const std::vector<float>& a, const std::vector<float>& b) {
+	if (a.size() != b.size())
+		return INFINITY;
+	double diff = 0.0;
+	for (size_t i = 0; i < a.size(); i++) {
+		if (std::isnan(a[i]) || std::isnan(b[i])) {
+			if (std::isnan(a[i]) != std::isnan(b[i]))
+				return INFINITY;
+			continue;
+		}
+		diff = std::max(diff, (double) std::fabs(a[i] - b[i]));
+	}
+	return diff;
+}
+
+int main(int argc, char** argv) {
+	int threads = std::max(1u, std::thread::hardware_concurrency());
+	std::string outDir = "build/render";
+	std::string refDir = "tools/render/golden";
+	bool update = false;
+	double tolerance = 1e-4;
+	int cpuLevel = CpuDispatch::BASELINE;
+	std::vector<Job> jobs;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--jobs" && i + 1 < argc) {
+			threads = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (arg == "--out" && i + 1 < argc) {
+			outDir = argv[++i];
+		}
+		else if (arg == "--ref" && i + 1 < argc) {
+			refDir = argv[++i];
+		}
+		else if (arg == "--update") {
+			update = true;
+		}
+		else if (arg == "--tolerance" && i + 1 < argc) {
+			tolerance = std::atof(argv[++i]);
+		}
+		else if (arg == "--cpu" && i + 1 < argc && CpuDispatch::parse(argv[i + 1]) >= 0) {
+			cpuLevel = CpuDispatch::parse(argv[++i]);
+		}
+		else if (arg[0] != '-') {
+			Job job;
+			job.path = arg;
+			size_t slash = arg.find_last_of("/\\");
+			job.name = arg.substr(slash == std::string::npos ? 0 : slash + 1);
+			job.name = job.name.substr(0, job.name.rfind('.'));
+			jobs.push_back(job);
+		}
+		else {
+			jobs.clear();
+			break;
+		}
+	}
+	if (jobs.empty()) {
+		std::fprintf(stderr, "usage: %s [--jobs N] [--out DIR] [--ref DIR] [--update] [--tolerance X] [--cpu baseline|avx2] SCRIPT...\n", argv[0]);
+		return 1;
+	}
+	// the plugin's init() selects the best level, choose after it ran
+	headless::plugin();
+	cpuLevel = CpuDispatch::select(cpuLevel);
+	for (Job& job : jobs) {
+		if (!parseScript(job))
+			return 1;
+	}
+
+	// a pool of workers taking the next job until none are left
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		for (size_t j; (j = next++) < jobs.size();) {
+			render(jobs[j]);
+		}
+	};
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> pool;
+	for (int t = 0; t < std::min(threads, (int) jobs.size()); t++) {
+		pool.emplace_back(worker);
+	}
+	for (std::thread& t : pool) {
+		t.join();
+	}
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	makeDirs(update ? refDir : outDir);
+	int failures = 0;
+	std::printf("job,frames,render_seconds,realtime_factor,max_diff,result\n");
+	for (Job& job : jobs) {
+		std::string path = (update ? refDir : outDir) + "/" + job.name + ".wav";
+		std::vector<float> reference;
+		if (!writeWav(path, job.samples, job.sampleRate)) {
+			job.result = "write-error";
+		}
+		else if (update) {
+			job.result = "updated";
+		}
+		else if (!readWav(refDir + "/" + job.name + ".wav", &reference)) {
+			// a new script, render-update adds it
+			job.result = "skip";
+		}
+		else {
+			job.maxDiff = maxDiff(job.samples, reference);
+			job.result = job.maxDiff <= tolerance ? "pass" : "FAIL";
+		}
+		if (job.result != "pass" && job.result != "updated" && job.result != "skip")
+			failures++;
+		std::printf("%s,%zu,%.3f,%.1f,%g,%s\n", job.name.c_str(), job.samples.size(), job.seconds, job.length / job.seconds, job.maxDiff, job.result.c_str());
+	}
+	std::fprintf(stderr, "%zu jobs on %d threads with %s kernels in %.2f s, %d failed\n", jobs.size(), std::min(threads, (int) jobs.size()), CpuDispatch::name(cpuLevel), wall, failures);
+	return failures > 0 ? 1 : 0;
+}
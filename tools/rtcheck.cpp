@@ -0,0 +1,609 @@
+/** Checks that the modules' audio paths never allocate, lock or block.
+ *
+ * Build and run with `make rtcheck`, Linux only, which `make test` and the
+ * plugin build on Linux also run. Usage:
+ *   rtcheck [--frames N]
+ * Each case patches the plugin's real modules on the headless engine of
+ * tools/headless, with their process() timers on, and steps it on the main
+ * thread, the audio thread here. Meanwhile a second thread does what
+ * Rack's UI thread does to them: loads presets through dataFromJson(),
+ * clicks every item of their context menus, turns knobs and loads voicing
+ * libraries through the file dialog. This binary replaces malloc and
+ * friends, pthread mutexes, spinlocks, condition variables, semaphores,
+ * opening files, stdio and the blocking libc calls with versions that
+ * forward to libc, and also record the call while the thread is inside an
+ * AudioThread scope. Prints one CSV row per case,
+ *   case,calls,violations,result
+ * then every distinct call site with its stack, and exits with 1 when
+ * any case made a forbidden call.
+ *
+ * Built, plugin sources included, without inlining and with -rdynamic so
+ * the stacks name the functions. Frames from static functions show as
+ * addresses, feed them to addr2line -e build/tools/rtcheck.
+ */
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+#include "harness.hpp"
+#include "headless.hpp"
+#include "plugin.hpp"
+#include "voicingbank.h"
+#include "voicinglibrary.h"
+
+using namespace harness;
+
+/** What the interposers below record. Everything here is fixed size, so
+ *  recording a violation neither allocates nor locks.
+ */
+namespace rtcheck {
+
+static const int MAX_FRAMES = 24;
+static const int MAX_SITES = 32;
+
+struct Site {
+	const char* call;
+	const char* checkCase;
+	void* frames[MAX_FRAMES];
+	int depth;
+	int count;
+};
+
+static Site sites[MAX_SITES];
+static std::atomic<int> siteCount(0);
+static std::atomic<int> violations(0);
+// the case AudioThread scopes report under
+static const char* currentCase = "";
+// set inside an AudioThread scope, cleared while recording a violation
+static thread_local bool armed = false;
+
+static void violation(const char* call) {
+	if (!armed)
+		return;
+	armed = false;
+	violations++;
+	void* frames[MAX_FRAMES + 2];
+	// skip violation() and the interposer
+	int depth = backtrace(frames, MAX_FRAMES + 2) - 2;
+	void** caller = frames + 2;
+	int n = std::min(siteCount.load(), MAX_SITES);
+	bool known = false;
+	for (int i = 0; i < n && !known; i++) {
+		Site& site = sites[i];
+		if (site.call == call && site.depth == depth && std::memcmp(site.frames, caller, depth * sizeof(void*)) == 0) {
+			site.count++;
+			known = true;
+		}
+	}
+	if (!known && n < MAX_SITES) {
+		Site& site = sites[n];
+		site.call = call;
+		site.checkCase = currentCase;
+		site.depth = depth;
+		site.count = 1;
+		std::memcpy(site.frames, caller, depth * sizeof(void*));
+		siteCount = n + 1;
+	}
+	else if (!known) {
+		siteCount = MAX_SITES + 1;
+	}
+	armed = true;
+}
+
+} // namespace rtcheck
+
+/** Marks the calling thread as the audio thread for its lifetime.
+ */
+struct AudioThread {
+	AudioThread() {
+		rtcheck::armed = true;
+	}
+	~AudioThread() {
+		rtcheck::armed = false;
+	}
+};
+
+extern "C" {
+
+// glibc's own allocator entry points, so the replacements below need no
+// dlsym(), which itself allocates
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* p);
+
+void* malloc(size_t size) {
+	rtcheck::violation("malloc");
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+	rtcheck::violation("calloc");
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) {
+	rtcheck::violation("realloc");
+	return __libc_realloc(p, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+	rtcheck::violation("memalign");
+	return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+	rtcheck::violation("aligned_alloc");
+	return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** p, size_t alignment, size_t size) {
+	rtcheck::violation("posix_memalign");
+	*p = __libc_memalign(alignment, size);
+	return *p || !size ? 0 : ENOMEM;
+}
+
+void free(void* p) {
+	// free(NULL) is a no-op, delete on an empty pointer should not count
+	if (p)
+		rtcheck::violation("free");
+	__libc_free(p);
+}
+
+} // extern "C"
+
+/** Defines name() to record the call and forward to the next definition,
+ *  normally libc's. The lookup happens on the first call, mostly before
+ *  any check is armed, otherwise what dlsym() allocates is recorded too.
+ */
+#define RTCHECK_FORWARD(ret, name, params, args) \
+	extern "C" ret name params { \
+		typedef ret (*Fn) params; \
+		static Fn next = NULL; \
+		if (!next) \
+			next = (Fn) dlsym(RTLD_NEXT, #name); \
+		rtcheck::violation(#name); \
+		return next args; \
+	}
+
+RTCHECK_FORWARD(int, pthread_mutex_lock, (pthread_mutex_t* m), (m))
+RTCHECK_FORWARD(int, pthread_mutex_timedlock, (pthread_mutex_t* m, const struct timespec* t), (m, t))
+RTCHECK_FORWARD(int, pthread_rwlock_rdlock, (pthread_rwlock_t* l), (l))
+RTCHECK_FORWARD(int, pthread_rwlock_wrlock, (pthread_rwlock_t* l), (l))
+RTCHECK_FORWARD(int, pthread_cond_wait, (pthread_cond_t* c, pthread_mutex_t* m), (c, m))
+RTCHECK_FORWARD(int, pthread_cond_timedwait, (pthread_cond_t* c, pthread_mutex_t* m, const struct timespec* t), (c, m, t))
+RTCHECK_FORWARD(int, pthread_join, (pthread_t t, void** r), (t, r))
+RTCHECK_FORWARD(int, sem_wait, (sem_t* s), (s))
+RTCHECK_FORWARD(int, sem_timedwait, (sem_t* s, const struct timespec* t), (s, t))
+RTCHECK_FORWARD(int, nanosleep, (const struct timespec* t, struct timespec* r), (t, r))
+RTCHECK_FORWARD(int, clock_nanosleep, (clockid_t c, int f, const struct timespec* t, struct timespec* r), (c, f, t, r))
+RTCHECK_FORWARD(int, usleep, (useconds_t u), (u))
+RTCHECK_FORWARD(unsigned, sleep, (unsigned s), (s))
+RTCHECK_FORWARD(int, sched_yield, (void), ())
+RTCHECK_FORWARD(ssize_t, read, (int fd, void* b, size_t n), (fd, b, n))
+RTCHECK_FORWARD(ssize_t, write, (int fd, const void* b, size_t n), (fd, b, n))
+RTCHECK_FORWARD(int, close, (int fd), (fd))
+RTCHECK_FORWARD(int, poll, (struct pollfd* f, nfds_t n, int t), (f, n, t))
+RTCHECK_FORWARD(void*, mmap, (void* a, size_t n, int p, int f, int fd, off_t o), (a, n, p, f, fd, o))
+RTCHECK_FORWARD(int, munmap, (void* a, size_t n), (a, n))
+
+RTCHECK_FORWARD(int, pthread_spin_lock, (pthread_spinlock_t* l), (l))
+RTCHECK_FORWARD(int, creat, (const char* path, mode_t mode), (path, mode))
+RTCHECK_FORWARD(FILE*, fopen, (const char* path, const char* mode), (path, mode))
+RTCHECK_FORWARD(FILE*, fopen64, (const char* path, const char* mode), (path, mode))
+RTCHECK_FORWARD(FILE*, freopen, (const char* path, const char* mode, FILE* f), (path, mode, f))
+RTCHECK_FORWARD(FILE*, fdopen, (int fd, const char* mode), (fd, mode))
+RTCHECK_FORWARD(int, fclose, (FILE* f), (f))
+RTCHECK_FORWARD(int, fflush, (FILE* f), (f))
+RTCHECK_FORWARD(size_t, fread, (void* b, size_t size, size_t n, FILE* f), (b, size, n, f))
+RTCHECK_FORWARD(size_t, fwrite, (const void* b, size_t size, size_t n, FILE* f), (b, size, n, f))
+RTCHECK_FORWARD(char*, fgets, (char* s, int n, FILE* f), (s, n, f))
+RTCHECK_FORWARD(int, fgetc, (FILE* f), (f))
+RTCHECK_FORWARD(int, getc, (FILE* f), (f))
+RTCHECK_FORWARD(int, fputs, (const char* s, FILE* f), (s, f))
+RTCHECK_FORWARD(int, puts, (const char* s), (s))
+RTCHECK_FORWARD(int, fputc, (int c, FILE* f), (c, f))
+RTCHECK_FORWARD(int, putc, (int c, FILE* f), (c, f))
+RTCHECK_FORWARD(int, putchar, (int c), (c))
+RTCHECK_FORWARD(int, vfprintf, (FILE* f, const char* format, va_list list), (f, format, list))
+RTCHECK_FORWARD(int, vprintf, (const char* format, va_list list), (format, list))
+
+/** Like RTCHECK_FORWARD for printf() and fprintf(), forwarding to the next
+ *  definition of their va_list variant.
+ */
+#define RTCHECK_FORWARD_PRINTF(name, vname, params, vparams, args) \
+	extern "C" int name params { \
+		typedef int (*Fn) vparams; \
+		static Fn next = NULL; \
+		if (!next) \
+			next = (Fn) dlsym(RTLD_NEXT, #vname); \
+		rtcheck::violation(#name); \
+		va_list list; \
+		va_start(list, format); \
+		int n = next args; \
+		va_end(list); \
+		return n; \
+	}
+
+RTCHECK_FORWARD_PRINTF(fprintf, vfprintf, (FILE* f, const char* format, ...), (FILE*, const char*, va_list), (f, format, list))
+RTCHECK_FORWARD_PRINTF(printf, vprintf, (const char* format, ...), (const char*, va_list), (format, list))
+
+/** Like RTCHECK_FORWARD for open() and its variants, which are variadic,
+ *  the mode only matters when they create a file.
+ */
+#define RTCHECK_FORWARD_OPEN(name, params, args) \
+	extern "C" int name params { \
+		typedef int (*Fn) params; \
+		static Fn next = NULL; \
+		if (!next) \
+			next = (Fn) dlsym(RTLD_NEXT, #name); \
+		rtcheck::violation(#name); \
+		mode_t mode = 0; \
+		if (flags & (O_CREAT | O_TMPFILE)) { \
+			va_list list; \
+			va_start(list, flags); \
+			mode = va_arg(list, int); \
+			va_end(list); \
+		} \
+		return next args; \
+	}
+
+RTCHECK_FORWARD_OPEN(open, (const char* path, int flags, ...), (path, flags, mode))
+RTCHECK_FORWARD_OPEN(open64, (const char* path, int flags, ...), (path, flags, mode))
+RTCHECK_FORWARD_OPEN(openat, (int dir, const char* path, int flags, ...), (dir, path, flags, mode))
+RTCHECK_FORWARD_OPEN(openat64, (int dir, const char* path, int flags, ...), (dir, path, flags, mode))
+
+static long frames = 48000;
+// frames per engine step, the audio thread is armed for one step at a time
+static const int BLOCK = 32;
+
+/** One case's row, counted from the violations its scopes recorded.
+ */
+struct Case {
+	const char* name;
+	long calls = 0;
+	int startViolations;
+
+	explicit Case(const char* name) : name(name) {
+		rtcheck::currentCase = name;
+		startViolations = rtcheck::violations;
+	}
+
+	int report() {
+		int found = rtcheck::violations - startViolations;
+		std::printf("%s,%ld,%d,%s\n", name, calls, found, found ? "FAIL" : "pass");
+		return found;
+	}
+};
+
+/** A case's patch on an engine of its own, which both of its threads see
+ *  as APP->engine.
+ */
+struct Patch {
+	rack::engine::Engine engine;
+	rack::window::Window window;
+	rack::Context context;
+
+	Patch() {
+		context.engine = &engine;
+		context.window = &window;
+		rack::contextSet(&context);
+		engine.setSampleRate(SAMPLE_RATE);
+	}
+
+	~Patch() {
+		engine.clear();
+		rack::contextSet(NULL);
+	}
+
+	/** Adds a module with its process() timer on.
+	 */
+	rack::engine::Module* add(const char* slug) {
+		rack::engine::Module* module = headless::addModule(slug);
+		dynamic_cast<TimedModule*>(module)->processTimer.enabled = true;
+		return module;
+	}
+
+	/** Steps the engine on this thread BLOCK frames at a time, each step
+	 *  inside an AudioThread scope after block(step) has set the inputs,
+	 *  and now and then changes the sample rate, which Rack also does on
+	 *  the audio thread. ui() runs over and over on a second thread until
+	 *  frames frames have been stepped, and the steps go on until it
+	 *  returns.
+	 */
+	template <typename Block, typename Ui>
+	void run(Case& check, Block block, Ui ui) {
+		static const float sampleRates[] = {44100.f, 96000.f, SAMPLE_RATE};
+		long modules = engine.getModuleIds().size();
+		std::atomic<bool> audioDone(false), uiDone(false);
+		std::thread uiThread([&]() {
+			rack::contextSet(&context);
+			do {
+				ui();
+			} while (!audioDone);
+			uiDone = true;
+		});
+		for (long step = 0; !uiDone; step++) {
+			{
+				AudioThread audio;
+				if (step % 512 == 511)
+					engine.setSampleRate(sampleRates[step / 512 % 3]);
+				block(step);
+				engine.stepBlock(BLOCK);
+			}
+			check.calls += BLOCK * modules;
+			if ((step + 1) * BLOCK >= frames)
+				audioDone = true;
+			// where a real audio thread waits for the device
+			std::this_thread::yield();
+		}
+		uiThread.join();
+	}
+};
+
+/** Clicks every item of the module's context menu that does something,
+ *  in menu order, then turns its process() timer back on.
+ */
+static void clickEverything(rack::engine::Module* module) {
+	for (const std::vector<std::string>& path : headless::menuActions(module)) {
+		headless::clickMenuItem(module, path);
+	}
+	dynamic_cast<TimedModule*>(module)->processTimer.enabled = true;
+}
+
+/** Softclip with its channel count and CV inputs changing, while the UI
+ *  thread goes through every saturation, oversampling and ADAA setting
+ *  by preset and by menu and turns the knobs.
+ */
+static int checkSoftclip() {
+	Case check("softclip");
+	Patch patch;
+	rack::engine::Module* softclip = patch.add("softclip");
+	int input = headless::findInput(softclip, "input");
+	int gainCv = headless::findInput(softclip, "gain-cv input");
+	int hardnessCv = headless::findInput(softclip, "hardness-cv input");
+	int gain = headless::findParam(softclip, "gain");
+	int hardness = headless::findParam(softclip, "knee hardness");
+	headless::plugOutput(softclip, headless::findOutput(softclip, "output"));
+	headless::plugOutput(softclip, headless::findOutput(softclip, "mixoutput"));
+	Signal in(0.f, 8.f, 3.f), cv(5.f, 5.f, 1.f);
+
+	patch.run(check,
+		[&](long step) {
+			headless::setInput(softclip, input, in.at(step), 1 + (int)(step / 8 % MAX_CHANNELS));
+			headless::setInput(softclip, gainCv, cv.at(step), (int)(step / 100 % 2));
+			headless::setInput(softclip, hardnessCv, cv.at(step), (int)(step / 70 % 2));
+		},
+		[&]() {
+			for (int mode = 0; mode < 2; mode++) {
+				for (int oversampling = 0; oversampling <= 3; oversampling++) {
+					for (int adaa = 0; adaa <= 2; adaa++) {
+						headless::setModuleData(softclip, rack::string::f("{\"saturationMode\": %d, \"oversampling\": %d, \"adaa\": %d}", mode, oversampling, adaa));
+						softclip->params[gain].setValue(adaa - 1.f);
+						softclip->params[hardness].setValue(oversampling / 3.f);
+					}
+				}
+			}
+			clickEverything(softclip);
+		}
+	);
+	return check.report();
+}
+
+/** Moggle with its morph channels changing and unpatched now and then,
+ *  while the UI thread loads snapshots and control rates by preset, adds,
+ *  removes and clears snapshots from the menu and turns the knobs.
+ */
+static int checkMoggle() {
+	Case check("moggle");
+	Patch patch;
+	rack::engine::Module* moggle = patch.add("Moggle");
+	int morphIn = headless::findInput(moggle, "morph amount cv input");
+	int knob1 = headless::findParam(moggle, "set value 1");
+	int knob2 = headless::findParam(moggle, "set value 2");
+	headless::plugOutput(moggle, headless::findOutput(moggle, "output"));
+	Signal morph(5.f, 5.f, 7.f);
+
+	patch.run(check,
+		[&](long step) {
+			headless::setInput(moggle, morphIn, morph.at(step), step / 64 % 4 == 3 ? 0 : 1 + (int)(step / 16 % MAX_CHANNELS));
+		},
+		[&]() {
+			for (int rate = 0; rate < 4; rate++) {
+				headless::setModuleData(moggle, rack::string::f("{\"controlRate\": %d, \"snapshots\": %s}", rate,
+					rate % 2 ? "[[1, 2, 3], [-4], [5, -5, 5, -5]]" : "[]"));
+				moggle->params[knob1].setValue(rate - 2.f);
+				moggle->params[knob2].setValue(4.f - rate);
+			}
+			clickEverything(moggle);
+		}
+	);
+	return check.report();
+}
+
+/** Writes a voicing library to a temporary file and returns its path, or
+ *  an empty one when that fails.
+ */
+static std::string makeLibrary() {
+	std::vector<std::vector<int>> voicings;
+	for (int v = 0; v < 32; v++) {
+		std::vector<int> voicing;
+		for (int i = 0; i <= v % VoicingBank::MAX_VOICES; i++) {
+			voicing.push_back(-i * (1 + v % 5));
+		}
+		voicings.push_back(voicing);
+	}
+	std::vector<uint8_t> data = VoicingLibrary::build(voicings);
+	char path[] = "/tmp/rtcheck-XXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0)
+		return "";
+	bool written = ::write(fd, data.data(), data.size()) == (ssize_t) data.size();
+	::close(fd);
+	if (!written) {
+		unlink(path);
+		return "";
+	}
+	return path;
+}
+
+/** Polyfotz with a VarTriSaw to its right, playing it over the expander
+ *  bus or, while VarTriSaw's V/Oct is patched, through the cables, with
+ *  the note count, aftertouch, pitchwheel and voicing CV changing. The UI
+ *  thread loads patch voicings and a voicing library through Polyfotz's
+ *  dataFromJson() and menu and turns its voicing knob, and switches
+ *  VarTriSaw's engine, unison and culling by preset and by menu.
+ */
+static int checkPolyfotzVarTriSaw(const std::string& libraryPath) {
+	Case check("polyfotz+vartrisaw");
+	Patch patch;
+	rack::engine::Module* polyfotz = patch.add("Polyfotz");
+	rack::engine::Module* vartrisaw = patch.add("VarTriSaw");
+	int cvIn = headless::findInput(polyfotz, "V/OCT");
+	int aftIn = headless::findInput(polyfotz, "aftertouch");
+	int pitchwheelIn = headless::findInput(polyfotz, "pitchwheel");
+	int voicingIn = headless::findInput(polyfotz, "voicing selection cv");
+	int voicingKnob = headless::findParam(polyfotz, "voicing selection");
+	int voctIn = headless::findInput(vartrisaw, "v/oct");
+	int gainIn = headless::findInput(vartrisaw, "poly gain in");
+	headless::plugOutput(vartrisaw, headless::findOutput(vartrisaw, "pwm triSaw"));
+	headless::plugOutput(vartrisaw, headless::findOutput(vartrisaw, "pwm square"));
+	Signal voct(0.f, 1.f, 2.f), aft(5.f, 5.f, 3.f), bend(0.f, 5.f, 1.f), voicing(5.f, 5.f, 5.f);
+
+	patch.run(check,
+		[&](long step) {
+			int notes = 1 + (int)(step / 16 % PORT_MAX_CHANNELS);
+			headless::setInput(polyfotz, cvIn, voct.at(step), notes);
+			headless::setInput(polyfotz, aftIn, aft.at(step), (int)(step / 128 % 2) * notes);
+			headless::setInput(polyfotz, pitchwheelIn, bend.at(step), 1);
+			headless::setInput(polyfotz, voicingIn, voicing.at(step), (int)(step / 96 % 2));
+			int cables = step / 200 % 3 == 2 ? notes : 0;
+			headless::setInput(vartrisaw, voctIn, voct.at(step), cables);
+			headless::setInput(vartrisaw, gainIn, aft.at(step), cables);
+		},
+		[&]() {
+			headless::setModuleData(polyfotz, "{\"polyInput\": true, \"voicings\": [[0, -3, -7], [0, -4, -7, -11], [0, -5, -10, -15, -19, -24], [0]]}");
+			headless::setModuleData(polyfotz, "{\"voicingLibrary\": \"" + libraryPath + "\"}");
+			for (int v = 0; v <= 24; v++) {
+				polyfotz->paramQuantities[voicingKnob]->setValue(v / 2.f);
+			}
+			headless::setModuleData(polyfotz, "{\"voicingLibrary\": \"\"}");
+			headless::answerFileDialog(libraryPath);
+			clickEverything(polyfotz);
+			headless::setModuleData(vartrisaw, "{\"engine\": 1, \"unison\": 4, \"unisonDetune\": 2, \"unisonPwSpread\": 3, \"cullHold\": 0}");
+			headless::setModuleData(vartrisaw, "{\"engine\": 0, \"unison\": 8, \"cullHold\": 4}");
+			clickEverything(vartrisaw);
+		}
+	);
+	return check.report();
+}
+
+/** Makes sure the interposers catch what they should, so a linker or libc
+ *  change cannot make every check pass unseen. Also takes backtrace()'s
+ *  first call, which loads libgcc, out of the checks.
+ */
+static bool selfTest() {
+	void* stack[4];
+	backtrace(stack, 4);
+	int before = rtcheck::violations;
+	std::mutex mutex;
+	pthread_spinlock_t spinlock;
+	pthread_spin_init(&spinlock, PTHREAD_PROCESS_PRIVATE);
+	{
+		AudioThread audio;
+		// volatile, or the compiler drops the pair
+		int* volatile p = new int(1);
+		delete p;
+		std::lock_guard<std::mutex> lock(mutex);
+		pthread_spin_lock(&spinlock);
+		pthread_spin_unlock(&spinlock);
+		FILE* f = std::fopen("/dev/null", "r");
+		if (f)
+			std::fclose(f);
+	}
+	pthread_spin_destroy(&spinlock);
+	int caught = rtcheck::violations - before;
+	rtcheck::violations = before;
+	rtcheck::siteCount = 0;
+	// new, delete, both locks, fopen and fclose, more for what fopen allocates
+	if (caught < 6) {
+		std::fprintf(stderr, "rtcheck: the self test caught %d of 6 calls, the interposers are not in effect\n", caught);
+		return false;
+	}
+	return true;
+}
+
+static void printSites() {
+	int n = std::min(rtcheck::siteCount.load(), rtcheck::MAX_SITES);
+	for (int i = 0; i < n; i++) {
+		const rtcheck::Site& site = rtcheck::sites[i];
+		std::printf("\n%s on the audio thread in %s, %d time%s:\n", site.call, site.checkCase, site.count, site.count == 1 ? "" : "s");
+		char** symbols = backtrace_symbols(site.frames, site.depth);
+		for (int f = 0; f < site.depth; f++) {
+			// binary(mangled+offset) [address]
+			std::string symbol = symbols ? symbols[f] : "?";
+			size_t open = symbol.find('(');
+			size_t plus = symbol.find('+', open);
+			if (open != std::string::npos && plus != std::string::npos && plus > open + 1) {
+				int status;
+				char* name = abi::__cxa_demangle(symbol.substr(open + 1, plus - open - 1).c_str(), NULL, NULL, &status);
+				if (status == 0) {
+					symbol = symbol.substr(0, open + 1) + name + symbol.substr(plus);
+				}
+				std::free(name);
+			}
+			std::printf("  #%d %s\n", f, symbol.c_str());
+			if (symbol.find(" main") != std::string::npos || symbol.find("(main+") != std::string::npos)
+				break;
+		}
+		std::free(symbols);
+	}
+	if (rtcheck::siteCount > rtcheck::MAX_SITES)
+		std::printf("\nand more call sites than fit here\n");
+}
+
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--frames" && i + 1 < argc) {
+			frames = std::max(64L, std::atol(argv[++i]));
+		}
+		else {
+			std::fprintf(stderr, "usage: %s [--frames N]\n", argv[0]);
+			return 1;
+		}
+	}
+	// the plugin's init() allocates and logs, keep it out of the checks
+	headless::plugin();
+	if (!selfTest())
+		return 1;
+	std::string libraryPath = makeLibrary();
+	if (libraryPath.empty()) {
+		std::fprintf(stderr, "rtcheck: could not write a voicing library\n");
+		return 1;
+	}
+
+	std::printf("case,calls,violations,result\n");
+	int failed = 0;
+	failed += checkSoftclip();
+	failed += checkMoggle();
+	failed += checkPolyfotzVarTriSaw(libraryPath);
+	printSites();
+	unlink(libraryPath.c_str());
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,85 @@
+# Headless tools, built without the Rack SDK: the DSP cores in src/ only
+# need the part of Rack's simd headers vendored in tools/headless/include.
+
+TOOL_CXXFLAGS := -std=c++11 -O3 -funsafe-math-optimizations -march=nehalem -Wall -Itools/headless/include -Isrc
+TOOL_OS := $(shell uname -s)
+
+# Headless DSP benchmarks, see tools/bench.cpp
+.PHONY: bench
+bench: build/tools/bench
+	build/tools/bench
+
+build/tools/bench: $(wildcard tools/bench*.cpp) tools/bench.hpp tools/harness.hpp src/voicinglibrary.cpp $(wildcard src/*.h)
+	@mkdir -p $(@D)
+	$(CXX) $(TOOL_CXXFLAGS) $(wildcard tools/bench*.cpp) src/voicinglibrary.cpp -o $@
+
+# Alias rejection against CPU cost per engine and mode, see tools/aliasing.cpp
+.PHONY: aliasing
+aliasing: build/tools/aliasing
+	build/tools/aliasing
+
+build/tools/aliasing: tools/aliasing.cpp tools/harness.hpp $(wildcard src/*.h)
+	@mkdir -p $(@D)
+	$(CXX) $(TOOL_CXXFLAGS) $< -o $@
+
+# Polyfotz voicing library builder, see tools/voicinglib.cpp
+.PHONY: voicinglib
+voicinglib: build/tools/voicinglib
+
+build/tools/voicinglib: tools/voicinglib.cpp src/voicinglibrary.cpp src/voicinglibrary.h
+	@mkdir -p $(@D)
+	$(CXX) $(TOOL_CXXFLAGS) $< src/voicinglibrary.cpp -o $@
+
+# The plugin's modules on the headless engine, see tools/headless/headless.hpp
+HEADLESS_SOURCES := $(wildcard src/*.cpp) tools/headless/headless.cpp
+HEADLESS_OBJECTS := $(patsubst %.cpp,build/tools/obj/%.o,$(HEADLESS_SOURCES))
+HEADLESS_HEADERS := $(wildcard src/*.h src/*.hpp tools/headless/*.hpp tools/headless/include/*.h tools/headless/include/*.hpp tools/headless/include/*/*.h tools/headless/include/*/*.hpp)
+
+$(HEADLESS_OBJECTS): build/tools/obj/%.o: %.cpp $(HEADLESS_HEADERS)
+	@mkdir -p $(@D)
+	$(CXX) $(TOOL_CXXFLAGS) -Itools/headless -c $< -o $@
+
+# Offline renders of the modules checked against the references in
+# tools/render/golden, see tools/render.cpp
+RENDER_SCRIPTS := $(wildcard tools/render/*.txt)
+
+.PHONY: render render-update
+render: build/tools/render
+	build/tools/render $(RENDER_SCRIPTS)
+
+render-update: build/tools/render
+	build/tools/render --update $(RENDER_SCRIPTS)
+
+build/tools/render: tools/render.cpp tools/harness.hpp $(HEADLESS_OBJECTS)
+	@mkdir -p $(@D)
+	$(CXX) $(TOOL_CXXFLAGS) -Itools/headless -pthread $< $(HEADLESS_OBJECTS) -o $@
+
+# Fails when a module's audio path allocates, locks or blocks, see tools/rtcheck.cpp.
+# The plugin's sources build again without inlining for readable stacks, and
+# without _FORTIFY_SOURCE so stdio calls reach the interposers by their names
+RTCHECK_CXXFLAGS := $(TOOL_CXXFLAGS) -O1 -fno-inline -g -U_FORTIFY_SOURCE -Itools/headless
+RTCHECK_OBJECTS := $(patsubst %.cpp,build/tools/rtcheck-obj/%.o,$(HEADLESS_SOURCES))
+
+.PHONY: rtcheck
+rtcheck: build/tools/rtcheck
+	build/tools/rtcheck
+
+$(RTCHECK_OBJECTS): build/tools/rtcheck-obj/%.o: %.cpp $(HEADLESS_HEADERS)
+	@mkdir -p $(@D)
+	$(CXX) $(RTCHECK_CXXFLAGS) -c $< -o $@
+
+build/tools/rtcheck: tools/rtcheck.cpp tools/harness.hpp $(RTCHECK_OBJECTS)
+	@mkdir -p $(@D)
+ifeq ($(TOOL_OS),Linux)
+	$(CXX) $(RTCHECK_CXXFLAGS) -rdynamic -pthread $< $(RTCHECK_OBJECTS) -o $@ -ldl
+else
+	$(error rtcheck replaces glibc's allocator and only builds on Linux)
+endif
+
+# Everything that fails on a regression: the real-time check where it
+# builds and the renders against their references
+.PHONY: test
+test: render
+ifeq ($(TOOL_OS),Linux)
+test: rtcheck
+endif
@@ -0,0 +1,86 @@
+/** Builds Polyfotz voicing libraries, see src/voicinglibrary.h.
+ *
+ * Build with `make voicinglib`. Usage:
+ *   voicinglib INPUT OUTPUT   text in, .nbvl out
+ *   voicinglib --dump FILE    prints a library back as text
+ * The text has one voicing per line, semitone offsets separated by spaces
+ * or commas, e.g. "0 -5 -10 -12". Blank lines and lines starting with #
+ * are skipped.
+ */
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "voicinglibrary.h"
+
+static int dump(const char* path) {
+	std::string error;
+	std::shared_ptr<const VoicingLibrary> library = VoicingLibrary::open(path, &error);
+	if (!library) {
+		std::fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+	for (int v = 0; v < library->count(); v++) {
+		for (int i = 0; i < library->size(v); i++) {
+			std::printf(i ? " %d" : "%d", library->voices(v)[i]);
+		}
+		std::printf("\n");
+	}
+	return 0;
+}
+
+static int build(const char* inPath, const char* outPath) {
+	std::ifstream in(inPath);
+	if (!in) {
+		std::fprintf(stderr, "Could not open %s\n", inPath);
+		return 1;
+	}
+	std::vector<std::vector<int>> voicings;
+	std::string line;
+	for (int lineNumber = 1; std::getline(in, line); lineNumber++) {
+		size_t start = line.find_first_not_of(" \t\r");
+		if (start == std::string::npos || line[start] == '#')
+			continue;
+		for (char& c : line) {
+			if (c == ',')
+				c = ' ';
+		}
+		std::istringstream fields(line);
+		std::vector<int> voicing;
+		int voice;
+		while (fields >> voice) {
+			if (voice < -128 || voice > 127) {
+				std::fprintf(stderr, "%s:%d: %d is out of range\n", inPath, lineNumber, voice);
+				return 1;
+			}
+			voicing.push_back(voice);
+		}
+		if (!fields.eof()) {
+			std::fprintf(stderr, "%s:%d: not a list of semitones\n", inPath, lineNumber);
+			return 1;
+		}
+		voicings.push_back(voicing);
+	}
+	if (voicings.empty()) {
+		std::fprintf(stderr, "%s has no voicings\n", inPath);
+		return 1;
+	}
+
+	std::vector<uint8_t> data = VoicingLibrary::build(voicings);
+	std::ofstream out(outPath, std::ios::binary);
+	out.write((const char*) data.data(), data.size());
+	if (!out) {
+		std::fprintf(stderr, "Could not write %s\n", outPath);
+		return 1;
+	}
+	std::printf("%zu voicings, %zu bytes\n", voicings.size(), data.size());
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	if (argc == 3 && std::string(argv[1]) == "--dump")
+		return dump(argv[2]);
+	if (argc == 3 && argv[1][0] != '-')
+		return build(argv[1], argv[2]);
+	std::fprintf(stderr, "usage: %s INPUT OUTPUT\n       %s --dump FILE\n", argv[0], argv[0]);
+	return 1;
+}